@@ -0,0 +1,471 @@
+// microbenchmark for the noise kernels on the chunk generation path. only
+// links the Util library so it runs on machines without a gpu or a window.
+//
+// usage: NoiseBenchmark [--repetitions n] [--warmup n] [--simd scalar|sse4.1|avx2]
+//                       [--json file|-]
+// with --json - the json goes to stdout and the readable report to stderr
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "marching_cubes.h"
+#include "mesh_optimizer.h"
+#include "noise_graph.h"
+#include "perlin_noise.h"
+#include "perlin_noise_simd.h"
+#include "scratch_arena.h"
+#include "simplex_noise.h"
+
+static const int CHUNK_SIZE{ 241 };
+static const int CHUNK_OCTAVES{ 6 };
+// Terrain::WATER_LEVEL, the terrain headers pull in vulkan
+static const float WATER_LEVEL{ -0.2942f };
+// Terrain::NOISE_TOLERANCE
+static const float COARSE_TOLERANCE{ 0.002f };
+// samples per repetition of the per-sample and batch cases
+static const int SAMPLE_COUNT{ 1 << 16 };
+
+// keeps the compiler from dropping the work being timed
+static volatile float s_sink;
+// where the readable report goes, stderr when stdout carries the json
+static std::ostream* s_report{ &std::cout };
+
+struct Settings {
+	int repetitions{ 30 };
+	int warmup{ 3 };
+	std::string json_path{};
+};
+
+struct Result {
+	std::string name;
+	size_t samples_per_rep;
+	// nanoseconds per sample, sorted
+	std::vector<double> ns_per_sample;
+
+	double percentile(double p) const
+	{
+		size_t index{ (size_t)(p / 100.0 * (ns_per_sample.size() - 1) + 0.5) };
+		return ns_per_sample[index];
+	}
+	double mean() const
+	{
+		double sum{ 0 };
+		for (double ns : ns_per_sample) sum += ns;
+		return sum / ns_per_sample.size();
+	}
+};
+
+class Benchmark {
+public:
+	Benchmark(const Settings& settings)
+		: m_settings(settings)
+	{}
+
+	// runs work(rep) for the warm-up and timed repetitions, each one
+	// evaluating samples_per_rep samples. prepare(rep) runs before each
+	// repetition and isn't timed
+	void run(const std::string& name, size_t samples_per_rep,
+		const std::function<void(int)>& prepare, const std::function<void(int)>& work)
+	{
+		for (int i{ 0 }; i < m_settings.warmup; i++) {
+			prepare(i);
+			work(i);
+		}
+
+		Result result{ name, samples_per_rep, {} };
+		for (int i{ 0 }; i < m_settings.repetitions; i++) {
+			prepare(m_settings.warmup + i);
+			auto start{ std::chrono::steady_clock::now() };
+			work(m_settings.warmup + i);
+			auto end{ std::chrono::steady_clock::now() };
+			double ns{ std::chrono::duration<double, std::nano>(end - start).count() };
+			result.ns_per_sample.push_back(ns / samples_per_rep);
+		}
+		std::sort(result.ns_per_sample.begin(), result.ns_per_sample.end());
+
+		std::ostream& report{ *s_report };
+		report.width(36);
+		report << std::left << name << std::right;
+		report.precision(2);
+		report << std::fixed
+			<< " p50 " << result.percentile(50) << " ns"
+			<< "  p90 " << result.percentile(90) << " ns"
+			<< "  p99 " << result.percentile(99) << " ns"
+			<< "  " << 1000.0 / result.percentile(50) << " Msamples/s\n";
+		m_results.push_back(std::move(result));
+	}
+
+	void writeJson(std::ostream& out) const
+	{
+		out << "{\n";
+		out << "  \"simd\": \"" << evn_util::simd::levelName(evn_util::simd::active()) << "\",\n";
+		out << "  \"repetitions\": " << m_settings.repetitions << ",\n";
+		out << "  \"warmup\": " << m_settings.warmup << ",\n";
+		out << "  \"results\": [\n";
+		for (size_t i{ 0 }; i < m_results.size(); i++) {
+			const Result& r{ m_results[i] };
+			out << "    {\"name\": \"" << r.name << "\""
+				<< ", \"samples_per_rep\": " << r.samples_per_rep
+				<< ", \"ns_per_sample\": {"
+				<< "\"min\": " << r.ns_per_sample.front()
+				<< ", \"mean\": " << r.mean()
+				<< ", \"p50\": " << r.percentile(50)
+				<< ", \"p90\": " << r.percentile(90)
+				<< ", \"p99\": " << r.percentile(99)
+				<< ", \"max\": " << r.ns_per_sample.back() << "}"
+				<< ", \"samples_per_second\": " << 1e9 / r.percentile(50) << "}"
+				<< (i + 1 < m_results.size() ? ",\n" : "\n");
+		}
+		out << "  ]\n}\n";
+	}
+
+private:
+	const Settings& m_settings;
+	std::vector<Result> m_results;
+};
+
+// scattered sample positions, offset every repetition so each one touches
+// new lattice cells like a moving camera would
+static void fillSamples(std::vector<float>& xs, std::vector<float>& ys, int rep)
+{
+	uint32_t state{ 0x9e3779b9u * (uint32_t)(rep + 1) };
+	for (size_t i{ 0 }; i < xs.size(); i++) {
+		state = state * 1664525u + 1013904223u;
+		xs[i] = (float)(state >> 8) / (float)(1 << 24) * 4096.0f;
+		state = state * 1664525u + 1013904223u;
+		ys[i] = (float)(state >> 8) / (float)(1 << 24) * 4096.0f;
+	}
+}
+
+static void fillChunk(std::vector<float>& xs, std::vector<float>& ys, int rep)
+{
+	for (int i{ 0 }; i < CHUNK_SIZE; i++) {
+		xs[i] = (float)(i + rep * (CHUNK_SIZE - 1));
+		ys[i] = (float)(i + (rep % 7) * (CHUNK_SIZE - 1));
+	}
+}
+
+static void benchmarkEngine(Benchmark& bench, const std::string& name, evn_util::NoiseEngine& engine)
+{
+	std::vector<float> xs(SAMPLE_COUNT);
+	std::vector<float> ys(SAMPLE_COUNT);
+
+	bench.run(name + " noise", SAMPLE_COUNT,
+		[&](int rep) { fillSamples(xs, ys, rep); },
+		[&](int) {
+		float sum{ 0.0f };
+		for (int i{ 0 }; i < SAMPLE_COUNT; i++)
+			sum += engine.noise(xs[i] / 16.0f, ys[i] / 16.0f);
+		s_sink = sum;
+	});
+
+	for (int octaves : { 1, 2, 4, 6, 8 }) {
+		bench.run(name + " octave x" + std::to_string(octaves), SAMPLE_COUNT,
+			[&](int rep) { fillSamples(xs, ys, rep); },
+			[&](int) {
+			float sum{ 0.0f };
+			for (int i{ 0 }; i < SAMPLE_COUNT; i++)
+				sum += engine.octaveNoise(xs[i], ys[i], octaves);
+			s_sink = sum;
+		});
+	}
+
+	std::vector<float> chunk_x(CHUNK_SIZE);
+	std::vector<float> chunk_y(CHUNK_SIZE);
+	std::vector<float> heights((size_t)CHUNK_SIZE * CHUNK_SIZE);
+	bench.run(name + " chunk grid", heights.size(),
+		[&](int rep) { fillChunk(chunk_x, chunk_y, rep); },
+		[&](int rep) {
+		engine.octaveNoiseGrid(chunk_x.data(), CHUNK_SIZE, chunk_y.data(), CHUNK_SIZE,
+			heights.data(), CHUNK_OCTAVES);
+		s_sink = heights[rep % heights.size()];
+	});
+}
+
+static void benchmarkPerlin(Benchmark& bench, const std::string& name, evn_util::PerlinNoise& perlin)
+{
+	benchmarkEngine(bench, name, perlin);
+
+	std::vector<float> xs(SAMPLE_COUNT);
+	std::vector<float> ys(SAMPLE_COUNT);
+	std::vector<float> out(SAMPLE_COUNT);
+	bench.run(name + " batch octave x6", SAMPLE_COUNT,
+		[&](int rep) { fillSamples(xs, ys, rep); },
+		[&](int rep) {
+		perlin.octavePerlinBatch(xs.data(), ys.data(), out.data(), SAMPLE_COUNT, CHUNK_OCTAVES);
+		s_sink = out[rep % SAMPLE_COUNT];
+	});
+
+	bench.run(name + " fixed octave<6, 16>", SAMPLE_COUNT,
+		[&](int rep) { fillSamples(xs, ys, rep); },
+		[&](int) {
+		float sum{ 0.0f };
+		for (int i{ 0 }; i < SAMPLE_COUNT; i++)
+			sum += perlin.octavePerlin<6, 16>(xs[i], ys[i]);
+		s_sink = sum;
+	});
+
+	// the chunk heightfield the way Terrain builds it, one sample at a time
+	std::vector<float> chunk_x(CHUNK_SIZE);
+	std::vector<float> chunk_y(CHUNK_SIZE);
+	bench.run(name + " chunk per-sample", (size_t)CHUNK_SIZE * CHUNK_SIZE,
+		[&](int rep) { fillChunk(chunk_x, chunk_y, rep); },
+		[&](int) {
+		float sum{ 0.0f };
+		for (int y{ 0 }; y < CHUNK_SIZE; y++)
+			for (int x{ 0 }; x < CHUNK_SIZE; x++)
+				sum += perlin.octavePerlin(chunk_x[x], chunk_y[y], CHUNK_OCTAVES);
+		s_sink = sum;
+	});
+
+	// the slopes with and without the low octaves on a sub-grid
+	std::vector<float> heights((size_t)CHUNK_SIZE * CHUNK_SIZE);
+	std::vector<float> slopes_x(heights.size());
+	std::vector<float> slopes_y(heights.size());
+	float tolerance{ perlin.coarseTolerance() };
+	for (float coarse : { 0.0f, COARSE_TOLERANCE }) {
+		perlin.setCoarseTolerance(coarse);
+		bench.run(name + (coarse > 0.0f ? " chunk grid slopes coarse octaves" : " chunk grid slopes"),
+			heights.size(),
+			[&](int rep) { fillChunk(chunk_x, chunk_y, rep); },
+			[&](int rep) {
+			perlin.octaveNoiseGridDerivatives(chunk_x.data(), CHUNK_SIZE, chunk_y.data(), CHUNK_SIZE,
+				heights.data(), slopes_x.data(), slopes_y.data(), CHUNK_OCTAVES);
+			s_sink = slopes_x[rep % heights.size()];
+		});
+	}
+	perlin.setCoarseTolerance(tolerance);
+}
+
+// the default terrain graph and a richer one with warping, ridges, terraces
+// and a biome blend, both over a whole chunk
+static void benchmarkGraphs(Benchmark& bench, std::shared_ptr<evn_util::NoiseEngine> engine)
+{
+	evn_util::NoiseGraph plain(engine);
+	plain.setOutput(plain.fbm(plain.coordX(), plain.coordY(), CHUNK_OCTAVES));
+	plain.compile();
+
+	evn_util::NoiseGraph rich(engine);
+	auto [warp_x, warp_y] = rich.domainWarp(rich.coordX(), rich.coordY(), 24.0f, 3, 0.5f);
+	evn_util::NoiseNode hills{ rich.fbm(warp_x, warp_y, CHUNK_OCTAVES) };
+	evn_util::NoiseNode mountains{ rich.scaleBias(rich.ridged(rich.coordX(), rich.coordY(), 5, 0.5f, 0.5f), 0.5f, -0.4f) };
+	evn_util::NoiseNode plateaus{ rich.terrace(hills, 6) };
+	evn_util::NoiseNode biome{ rich.fbm(rich.coordX(), rich.coordY(), 2, 0.5f, 0.125f) };
+	evn_util::NoiseNode land{ rich.select(plateaus, mountains, biome, 0.0f, 0.15f) };
+	rich.setOutput(rich.clamp(land, -1.0f, 1.0f));
+	rich.compile();
+
+	std::vector<float> chunk_x(CHUNK_SIZE);
+	std::vector<float> chunk_y(CHUNK_SIZE);
+	std::vector<float> heights((size_t)CHUNK_SIZE * CHUNK_SIZE);
+	for (auto graph : { std::make_pair("graph fbm", &plain), std::make_pair("graph rich", &rich) }) {
+		bench.run(graph.first, heights.size(),
+			[&](int rep) { fillChunk(chunk_x, chunk_y, rep); },
+			[&](int rep) {
+			graph.second->evaluateGrid(chunk_x.data(), CHUNK_SIZE, chunk_y.data(), CHUNK_SIZE, heights.data());
+			s_sink = heights[rep % heights.size()];
+		});
+	}
+
+	// heights plus the analytic slopes the terrain builds its normals from
+	std::vector<float> slopes_x(heights.size());
+	std::vector<float> slopes_y(heights.size());
+	bench.run("graph fbm slopes", heights.size(),
+		[&](int rep) { fillChunk(chunk_x, chunk_y, rep); },
+		[&](int rep) {
+		plain.evaluateGrid(chunk_x.data(), CHUNK_SIZE, chunk_y.data(), CHUNK_SIZE, heights.data(),
+			slopes_x.data(), slopes_y.data());
+		s_sink = slopes_x[rep % heights.size()];
+	});
+
+	// an ocean heavy world, most samples settle under the water level after
+	// the first octaves and stop there
+	evn_util::NoiseGraph ocean(engine);
+	ocean.setOutput(ocean.scaleBias(ocean.fbm(ocean.coordX(), ocean.coordY(), CHUNK_OCTAVES), 1.0f, -0.9f));
+	ocean.compile();
+	for (float cutoff : { evn_util::NO_CUTOFF, WATER_LEVEL }) {
+		bench.run(cutoff == evn_util::NO_CUTOFF ? "graph ocean" : "graph ocean water cutoff", heights.size(),
+			[&](int rep) { fillChunk(chunk_x, chunk_y, rep); },
+			[&](int rep) {
+			ocean.evaluateGrid(chunk_x.data(), CHUNK_SIZE, chunk_y.data(), CHUNK_SIZE, heights.data(),
+				nullptr, nullptr, cutoff);
+			s_sink = heights[rep % heights.size()];
+		});
+	}
+
+	// what Terrain runs per chunk: the ocean bound, then the perlin grid
+	// with the water cutoff
+	auto terrain_engine{ std::make_shared<evn_util::PerlinNoise>(16, evn_util::GradientMode::Table) };
+	terrain_engine->setCoarseTolerance(COARSE_TOLERANCE);
+	evn_util::NoiseGraph terrain(terrain_engine);
+	terrain.setOutput(terrain.fbm(terrain.coordX(), terrain.coordY(), CHUNK_OCTAVES));
+	terrain.compile();
+	bench.run("graph terrain", heights.size(),
+		[&](int rep) { fillChunk(chunk_x, chunk_y, rep); },
+		[&](int rep) {
+		if (!terrain.below(chunk_x.front(), chunk_x.back(), chunk_y.front(), chunk_y.back(), WATER_LEVEL))
+			terrain.evaluateGrid(chunk_x.data(), CHUNK_SIZE, chunk_y.data(), CHUNK_SIZE, heights.data(),
+				nullptr, nullptr, WATER_LEVEL);
+		s_sink = heights[rep % heights.size()];
+	});
+
+	// the graphs and the perlin grid kernels take all their buffers from
+	// the thread's scratch arena, after the first chunk every one of them
+	// should come out of memory it had
+	const evn_util::ScratchArena::Stats& arena{ evn_util::ScratchArena::local().stats() };
+	*s_report << "scratch arena heap allocations " << arena.heap_allocations
+		<< ", reused " << arena.bytes_reused / 1024 << " of "
+		<< arena.bytes_allocated / 1024 << " KB, high water "
+		<< arena.high_water / 1024 << " KB\n";
+}
+
+// 3d noise and the marching cubes pass of a volume chunk, 80 x 32 x 80 cells
+static void benchmarkVolume(Benchmark& bench, evn_util::PerlinNoise& perlin)
+{
+	std::vector<float> xs(SAMPLE_COUNT);
+	std::vector<float> ys(SAMPLE_COUNT);
+	std::vector<float> zs(SAMPLE_COUNT);
+	std::vector<float> out(SAMPLE_COUNT);
+	bench.run("perlin table 3d batch x4", SAMPLE_COUNT,
+		[&](int rep) {
+		fillSamples(xs, ys, rep);
+		fillSamples(zs, out, rep + 1000);
+	},
+		[&](int rep) {
+		perlin.octavePerlin3Batch(xs.data(), ys.data(), zs.data(), out.data(), SAMPLE_COUNT, 4);
+		s_sink = out[rep % SAMPLE_COUNT];
+	});
+
+	const int cells{ 80 };
+	const int layers{ 32 };
+	std::vector<float> density((size_t)(cells + 1) * (layers + 1) * (cells + 1));
+	evn_util::DensityField field{ density.data(), cells, layers, cells };
+	for (int z{ 0 }; z <= cells; z++)
+		for (int y{ 0 }; y <= layers; y++)
+			for (int x{ 0 }; x <= cells; x++)
+				density[field.index(x, y, z)] = perlin.octavePerlin3(x * 3.0f, y * 3.0f, z * 3.0f, 4)
+					+ (16.0f - y) / 8.0f;
+	evn_util::IsoMesh mesh;
+	bench.run("marching cubes volume chunk", (size_t)cells * layers * cells,
+		[&](int) {},
+		[&](int) {
+		evn_util::marchingCubes(field, 0.0f, mesh);
+		s_sink = (float)mesh.indices.size();
+	});
+}
+
+// prints the vertex shader runs per triangle of indices before and after
+// reordering them, and times the reorder
+template<typename Index>
+static void benchmarkMeshOrder(Benchmark& bench, const std::string& name,
+	const std::vector<Index>& indices, size_t vertex_count)
+{
+	std::vector<Index> optimized{ indices };
+	evn_util::optimizeVertexCache(optimized.data(), optimized.size(), vertex_count);
+	*s_report << name << " acmr "
+		<< evn_util::averageCacheMissRatio(indices.data(), indices.size(), vertex_count) << " -> "
+		<< evn_util::averageCacheMissRatio(optimized.data(), optimized.size(), vertex_count) << "\n";
+
+	bench.run(name + " vertex cache order", indices.size() / 3,
+		[&](int) { optimized = indices; },
+		[&](int) {
+		evn_util::optimizeVertexCache(optimized.data(), optimized.size(), vertex_count);
+		s_sink = (float)optimized[0];
+	});
+}
+
+// the terrain's row by row grid and a marching cubes surface
+static void benchmarkMeshOrders(Benchmark& bench, evn_util::PerlinNoise& perlin)
+{
+	std::vector<uint16_t> grid;
+	for (int y{ 0 }; y < CHUNK_SIZE - 1; y++) {
+		for (int x{ 0 }; x < CHUNK_SIZE - 1; x++) {
+			uint16_t v{ (uint16_t)(y * CHUNK_SIZE + x) };
+			grid.insert(grid.end(), { v, (uint16_t)(v + CHUNK_SIZE + 1), (uint16_t)(v + CHUNK_SIZE),
+				(uint16_t)(v + CHUNK_SIZE + 1), v, (uint16_t)(v + 1) });
+		}
+	}
+	benchmarkMeshOrder(bench, "terrain grid", grid, (size_t)CHUNK_SIZE * CHUNK_SIZE);
+
+	const int cells{ 80 };
+	const int layers{ 32 };
+	std::vector<float> density((size_t)(cells + 1) * (layers + 1) * (cells + 1));
+	evn_util::DensityField field{ density.data(), cells, layers, cells };
+	for (int z{ 0 }; z <= cells; z++)
+		for (int y{ 0 }; y <= layers; y++)
+			for (int x{ 0 }; x <= cells; x++)
+				density[field.index(x, y, z)] = perlin.octavePerlin3(x * 3.0f, y * 3.0f, z * 3.0f, 4)
+					+ (16.0f - y) / 8.0f;
+	evn_util::IsoMesh mesh;
+	evn_util::marchingCubes(field, 0.0f, mesh);
+	benchmarkMeshOrder(bench, "volume chunk", mesh.indices, mesh.positions.size());
+}
+
+static bool parseArgs(int argc, char** argv, Settings& settings)
+{
+	for (int i{ 1 }; i < argc; i++) {
+		std::string arg{ argv[i] };
+		bool has_value{ i + 1 < argc };
+		if (arg == "--repetitions" && has_value) {
+			settings.repetitions = std::max(1, std::atoi(argv[++i]));
+		} else if (arg == "--warmup" && has_value) {
+			settings.warmup = std::max(0, std::atoi(argv[++i]));
+		} else if (arg == "--json" && has_value) {
+			settings.json_path = argv[++i];
+		} else if (arg == "--simd" && has_value) {
+			std::string level{ argv[++i] };
+			if (level == "scalar") evn_util::simd::setLevel(evn_util::simd::Level::Scalar);
+			else if (level == "sse4.1") evn_util::simd::setLevel(evn_util::simd::Level::SSE41);
+			else if (level == "avx2") evn_util::simd::setLevel(evn_util::simd::Level::AVX2);
+			else return false;
+		} else {
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	Settings settings{};
+	if (!parseArgs(argc, argv, settings)) {
+		std::cerr << "usage: " << argv[0] << " [--repetitions n] [--warmup n]"
+			<< " [--simd scalar|sse4.1|avx2] [--json file|-]\n";
+		return 1;
+	}
+
+	if (settings.json_path == "-")
+		s_report = &std::cerr;
+	*s_report << "simd: " << evn_util::simd::levelName(evn_util::simd::active())
+		<< ", repetitions: " << settings.repetitions
+		<< ", warm-up: " << settings.warmup << "\n";
+
+	Benchmark bench(settings);
+	evn_util::PerlinNoise perlin_hash(16);
+	evn_util::PerlinNoise perlin_table(16, evn_util::GradientMode::Table);
+	evn_util::SimplexNoise simplex(16);
+
+	benchmarkPerlin(bench, "perlin hash", perlin_hash);
+	benchmarkPerlin(bench, "perlin table", perlin_table);
+	benchmarkEngine(bench, "simplex", simplex);
+	benchmarkGraphs(bench, std::make_shared<evn_util::PerlinNoise>(16, evn_util::GradientMode::Table));
+	benchmarkVolume(bench, perlin_table);
+	benchmarkMeshOrders(bench, perlin_table);
+
+	if (settings.json_path == "-") {
+		bench.writeJson(std::cout);
+	} else if (!settings.json_path.empty()) {
+		std::ofstream file(settings.json_path);
+		if (!file.is_open()) {
+			std::cerr << "failed to open " << settings.json_path << "\n";
+			return 1;
+		}
+		bench.writeJson(file);
+	}
+	return 0;
+}
@@ -22,9 +22,11 @@ const std::vector<uint32_t> indices = {
 namespace evn {
 	App::App(const std::string& name)
 		: m_name(name), m_window(Window(WIDTH, HEIGHT, m_name)),
-		m_device(m_window), m_swapchain(m_device, m_window.getExtent(), m_window),
-		m_cam(m_device, WIDTH, HEIGHT, 13.0f), m_terrain_generator(m_device, m_cam)
+		m_device(m_window), m_buffer_pool(m_device),
+		m_swapchain(m_device, m_window.getExtent(), m_window),
+		m_cam(m_device, WIDTH, HEIGHT, 13.0f), m_terrain_generator(m_device, m_buffer_pool, m_cam)
 	{
+		m_cam.setFarPlane(m_terrain_generator.renderDistance());
 		setUpPipelineLayout();
 		createPipeline();
 	}
@@ -39,7 +41,7 @@ namespace evn {
 		float delta_time{ 0 };
 		// TEMPORARY CREATE AN OBJECT
 		Data data{ vertices, indices };
-		Mesh obj(m_device, data);
+		Mesh obj(m_buffer_pool, data);
 
 		// Terrain terrain(m_device, 0, 0);
 		// Terrain second_terrain(m_device, -241, -241);
@@ -48,14 +50,21 @@ namespace evn {
 			glfwPollEvents();
 			
 			auto command_buffer = m_swapchain.beginRendering();
-			m_pipeline->bind(command_buffer);
+			// the frame that last used this one's resources has finished
+			m_buffer_pool.nextFrame();
+			if (m_terrain_generator.chunkType() == ChunkType::Volume)
+				m_pipeline->bind(command_buffer);
+			else if (m_terrain_generator.vertexSource() == VertexSource::Heightmap)
+				m_heightmap_pipeline->bind(command_buffer);
+			else
+				m_terrain_pipeline->bind(command_buffer);
 			m_cam.update(command_buffer, m_layout, m_swapchain.currentFrame(),
 				m_window.getWindow(), delta_time);
 			// obj.bind(command_buffer);
 			// obj.draw(command_buffer);
 			// terrain.update(command_buffer);
 			// second_terrain.update(command_buffer);
-			m_terrain_generator.update(command_buffer);
+			m_terrain_generator.update(command_buffer, m_layout);
 			m_swapchain.endRendering();
 
 			auto end{ std::chrono::steady_clock::now() };
@@ -69,13 +78,21 @@ namespace evn {
 	}
 	void App::setUpPipelineLayout()
 	{
+		// chunks push their offset before drawing
+		VkPushConstantRange push_range{};
+		push_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+		push_range.offset = 0;
+		push_range.size = sizeof(ChunkPushConstants);
+
 		VkPipelineLayoutCreateInfo pipeline_info{};
 		pipeline_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 		pipeline_info.setLayoutCount = 0;
-		pipeline_info.pushConstantRangeCount = 0;
-		pipeline_info.pPushConstantRanges = nullptr;
-		pipeline_info.setLayoutCount = 1;
-		pipeline_info.pSetLayouts = &m_cam.layout();
+		pipeline_info.pushConstantRangeCount = 1;
+		pipeline_info.pPushConstantRanges = &push_range;
+		// the camera's uniforms, then the heightmap of the chunk being drawn
+		VkDescriptorSetLayout set_layouts[] = { m_cam.layout(), m_terrain_generator.heightmapLayout() };
+		pipeline_info.setLayoutCount = 2;
+		pipeline_info.pSetLayouts = set_layouts;
 
 		if (vkCreatePipelineLayout(m_device.device(), &pipeline_info, nullptr, &m_layout) != VK_SUCCESS)
 			throw std::runtime_error("failed to create pipeline layout");
@@ -89,6 +106,18 @@ namespace evn {
 
 		m_pipeline = std::make_unique<Pipeline>(m_device,
 			"shaders/shader.vert.spv", "shaders/shader.frag.spv", config);
+
+		// same state, the vertices are unpacked in terrain.vert
+		config.binding_descriptions = { TerrainVertex::getBindingDesc() };
+		config.attribute_descriptions = TerrainVertex::getAttributes();
+		m_terrain_pipeline = std::make_unique<Pipeline>(m_device,
+			"shaders/terrain.vert.spv", "shaders/shader.frag.spv", config);
+
+		// no vertex input at all, heightmap.vert reads the chunk's samples
+		config.binding_descriptions.clear();
+		config.attribute_descriptions.clear();
+		m_heightmap_pipeline = std::make_unique<Pipeline>(m_device,
+			"shaders/heightmap.vert.spv", "shaders/shader.frag.spv", config);
 	}
 	
 }
\ No newline at end of file
@@ -20,10 +20,16 @@ namespace evn {
 		std::string m_name;
 		Window m_window;
 		Device m_device;
+		// outlives everything that draws from its buffers
+		BufferPool m_buffer_pool;
 		Swapchain m_swapchain;
 		Camera m_cam;
 		VkPipelineLayout m_layout;
 		std::unique_ptr<Pipeline> m_pipeline;
+		// heightfield chunks with the packed TerrainVertex
+		std::unique_ptr<Pipeline> m_terrain_pipeline;
+		// heightfield chunks that pull their vertices from a Heightmap
+		std::unique_ptr<Pipeline> m_heightmap_pipeline;
 		EndlessTerrain m_terrain_generator;
 	};
 }
\ No newline at end of file
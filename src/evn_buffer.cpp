@@ -1,8 +1,11 @@
 #include "evn_buffer.h"
+#include <algorithm>
+#include "evn_swapchain.h"
 
 namespace evn {
 	Buffer::Buffer(Device& device, const VkDeviceSize& size, const VkBufferUsageFlags& usage, const VkMemoryPropertyFlags& properties)
-		: r_device(device), m_buffer(VK_NULL_HANDLE), m_memory(VK_NULL_HANDLE), m_size(size), p_data(nullptr)
+		: r_device(device), m_buffer(VK_NULL_HANDLE), m_memory(VK_NULL_HANDLE), m_size(size),
+		m_usage(usage), m_properties(properties), p_data(nullptr)
 	{
 		createBuffer(size, usage, properties, m_buffer, m_memory);
 	}
@@ -33,7 +36,8 @@ namespace evn {
 
 	void Buffer::map()
 	{
-		vkMapMemory(r_device.device(), m_memory, 0, m_size, 0, &p_data);
+		if (!p_data)
+			vkMapMemory(r_device.device(), m_memory, 0, m_size, 0, &p_data);
 	}
 
 	void Buffer::writeToBuffer(void* data)
@@ -41,6 +45,11 @@ namespace evn {
 		memcpy(p_data, data, m_size);
 	}
 
+	void Buffer::writeToBuffer(const void* data, VkDeviceSize size)
+	{
+		memcpy(p_data, data, size);
+	}
+
 
 	void Buffer::createBuffer(const VkDeviceSize& size,
 		const VkBufferUsageFlags& usage,
@@ -70,5 +79,86 @@ namespace evn {
 
 		vkBindBufferMemory(r_device.device(), buffer, buffer_memory, 0);
 	}
-	
+
+	BufferPool::BufferPool(Device& device)
+		: r_device(device), m_frame(0), m_free_bytes(0), m_free_device_bytes(0)
+	{}
+
+	std::unique_ptr<Buffer> BufferPool::acquire(VkDeviceSize size, VkBufferUsageFlags usage,
+		VkMemoryPropertyFlags properties)
+	{
+		VkDeviceSize class_size{ classSize(size) };
+		auto it{ m_free.find({ class_size, usage, properties }) };
+		if (it != m_free.end() && !it->second.empty()) {
+			std::unique_ptr<Buffer> buffer{ std::move(it->second.back()) };
+			it->second.pop_back();
+			track(*buffer, false);
+			return buffer;
+		}
+		return std::make_unique<Buffer>(r_device, class_size, usage, properties);
+	}
+
+	void BufferPool::release(std::unique_ptr<Buffer> buffer)
+	{
+		if (buffer)
+			m_released.push_back({ m_frame, std::move(buffer) });
+	}
+
+	std::unique_ptr<Buffer> BufferPool::upload(const void* data, VkDeviceSize size, VkBufferUsageFlags usage)
+	{
+		std::unique_ptr<Buffer> staging{ acquire(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) };
+		staging->map();
+		staging->writeToBuffer(data, size);
+
+		std::unique_ptr<Buffer> buffer{ acquire(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) };
+		buffer->copyBuffer(staging->getBuffer(), size);
+		// the copy has finished, nothing else can be using the staging buffer
+		recycle(std::move(staging));
+		return buffer;
+	}
+
+	void BufferPool::nextFrame()
+	{
+		m_frame++;
+		auto done{ std::partition(m_released.begin(), m_released.end(),
+			[&](const Released& released) { return released.frame + MAX_FRAMES_IN_FLIGHT > m_frame; }) };
+		for (auto it{ done }; it != m_released.end(); it++)
+			recycle(std::move(it->buffer));
+		m_released.erase(done, m_released.end());
+	}
+
+	VkDeviceSize BufferPool::classSize(VkDeviceSize size)
+	{
+		if (size <= MIN_SIZE_CLASS)
+			return MIN_SIZE_CLASS;
+		// the power of two below size, split into even steps up to the next
+		VkDeviceSize base{ MIN_SIZE_CLASS };
+		while (base * 2 < size)
+			base <<= 1;
+		VkDeviceSize step{ base / SIZE_CLASS_STEPS };
+		return (size + step - 1) / step * step;
+	}
+
+	void BufferPool::recycle(std::unique_ptr<Buffer> buffer)
+	{
+		auto& free{ m_free[{ buffer->size(), buffer->usage(), buffer->properties() }] };
+		if (free.size() >= MAX_FREE_PER_CLASS || m_free_bytes + buffer->size() > MAX_FREE_BYTES)
+			return;
+		track(*buffer, true);
+		free.push_back(std::move(buffer));
+	}
+
+	void BufferPool::track(const Buffer& buffer, bool free)
+	{
+		VkDeviceSize device_bytes{ (buffer.properties() & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) ? buffer.size() : 0 };
+		if (free) {
+			m_free_bytes += buffer.size();
+			m_free_device_bytes += device_bytes;
+		} else {
+			m_free_bytes -= buffer.size();
+			m_free_device_bytes -= device_bytes;
+		}
+	}
 }
\ No newline at end of file
@@ -1,4 +1,8 @@
 #pragma once
+#include <map>
+#include <memory>
+#include <tuple>
+#include <vector>
 #include "evn_device.h"
 namespace evn {
 	class Buffer {
@@ -8,10 +12,17 @@ namespace evn {
 			const VkBufferUsageFlags& usage,
 			const VkMemoryPropertyFlags& properties);
 		~Buffer();
+		Buffer(const Buffer&) = delete;
+		Buffer& operator=(const Buffer&) = delete;
 		inline VkBuffer& getBuffer() { return m_buffer; }
+		inline VkDeviceSize size() const { return m_size; }
+		inline VkBufferUsageFlags usage() const { return m_usage; }
+		inline VkMemoryPropertyFlags properties() const { return m_properties; }
 		void copyBuffer(VkBuffer& src_buffer, const VkDeviceSize& size);
+		// stays mapped until the buffer is destroyed
 		void map();
 		void writeToBuffer(void* data);
+		void writeToBuffer(const void* data, VkDeviceSize size);
 	private:
 		void createBuffer(const VkDeviceSize& size,
 			const VkBufferUsageFlags& usage,
@@ -24,6 +35,59 @@ namespace evn {
 		VkBuffer m_buffer;
 		VkDeviceMemory m_memory;
 		VkDeviceSize m_size;
+		VkBufferUsageFlags m_usage;
+		VkMemoryPropertyFlags m_properties;
 		void* p_data;
 	};
+
+	// keeps released buffers and hands them out again instead of creating
+	// new ones, chunks streaming in and out would otherwise allocate device
+	// memory every time. buffers are sorted into size classes an eighth of
+	// a power of two apart and may be up to that much larger than asked for
+	class BufferPool {
+	public:
+		BufferPool(Device& device);
+		BufferPool(const BufferPool&) = delete;
+		BufferPool& operator=(const BufferPool&) = delete;
+		inline Device& device() { return r_device; }
+		std::unique_ptr<Buffer> acquire(VkDeviceSize size, VkBufferUsageFlags usage,
+			VkMemoryPropertyFlags properties);
+		// frames in flight may still read the buffer, it is handed out again
+		// MAX_FRAMES_IN_FLIGHT frames later
+		void release(std::unique_ptr<Buffer> buffer);
+		// a device local buffer with size bytes of data, copied in through a
+		// recycled staging buffer
+		std::unique_ptr<Buffer> upload(const void* data, VkDeviceSize size, VkBufferUsageFlags usage);
+		// called once a frame, before recording it
+		void nextFrame();
+		// bytes of the free buffers waiting to be handed out again, all of
+		// them and only the device local ones. released buffers still held
+		// for their frames aren't counted until they are recycled
+		inline VkDeviceSize freeBytes() const { return m_free_bytes; }
+		inline VkDeviceSize freeDeviceBytes() const { return m_free_device_bytes; }
+	public:
+		const static VkDeviceSize MIN_SIZE_CLASS = 256;
+		// classes between two powers of two
+		const static VkDeviceSize SIZE_CLASS_STEPS = 8;
+		// free buffers kept per size class and in all, the rest are destroyed
+		const static size_t MAX_FREE_PER_CLASS = 32;
+		const static VkDeviceSize MAX_FREE_BYTES = 32ull << 20;
+	private:
+		using SizeClass = std::tuple<VkDeviceSize, VkBufferUsageFlags, VkMemoryPropertyFlags>;
+		static VkDeviceSize classSize(VkDeviceSize size);
+		void recycle(std::unique_ptr<Buffer> buffer);
+		// counts a buffer going onto a free list or coming off it
+		void track(const Buffer& buffer, bool free);
+	private:
+		struct Released {
+			uint64_t frame;
+			std::unique_ptr<Buffer> buffer;
+		};
+		Device& r_device;
+		std::map<SizeClass, std::vector<std::unique_ptr<Buffer>>> m_free;
+		std::vector<Released> m_released;
+		uint64_t m_frame;
+		VkDeviceSize m_free_bytes;
+		VkDeviceSize m_free_device_bytes;
+	};
 }
\ No newline at end of file
@@ -4,7 +4,7 @@ namespace evn {
 	Camera::Camera(Device& device, uint32_t width, uint32_t height,
 		float speed, float sens)
 		: r_device(device), m_pos(0, 0, -3), m_front(0, 0, 1), m_up(0, 1, 0),
-		m_direction(0), m_view(0), m_yaw(-90.0f), 
+		m_direction(0), m_view(0), m_far(150.0f), m_yaw(-90.0f), 
 		m_pitch(0), m_first_click(true), m_last_x(height / 2),
 		m_last_y(width / 2), m_sens(sens), m_speed(speed),
 		m_width(width), m_height(height)
@@ -34,8 +34,9 @@ namespace evn {
 		m_view = glm::lookAt(m_pos, m_pos + m_front, m_up);
 		ubo.view = m_view;
 		ubo.proj = glm::perspective(glm::radians(45.0f), (float)(m_width / m_height),
-			0.1f, 150.0f);
+			0.1f, m_far);
 		ubo.proj[1][1] *= -1;
+		m_frustum = evn_util::Frustum(ubo.proj * m_view);
 		m_uniform_buffers[image_index]->writeToBuffer((void*)&ubo);
 
 		vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
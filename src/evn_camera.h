@@ -4,6 +4,7 @@
 #include <memory>
 #include "evn_buffer.h"
 #include "evn_swapchain.h"
+#include "util/frustum.h"
 
 namespace evn {
 	struct ViewUniformBuffer {
@@ -19,6 +20,12 @@ namespace evn {
 		void update(VkCommandBuffer& command_buffer, VkPipelineLayout& pipeline_layout, 
 			uint32_t curr_frame, GLFWwindow* window, float delta_time);
 		inline VkDescriptorSetLayout& layout() { return m_descriptor_layout; }
+		// far clip distance, should reach as far as the terrain is drawn
+		inline void setFarPlane(float far_plane) { m_far = far_plane; }
+		// unit vector the camera looks along
+		inline const glm::vec3& front() const { return m_front; }
+		// what the last update's view and projection can see
+		inline const evn_util::Frustum& frustum() const { return m_frustum; }
 
 	public:
 		glm::vec3 m_pos; // public to allow other classes to get access
@@ -45,6 +52,8 @@ namespace evn {
 		glm::vec3 m_up;
 		glm::vec3 m_direction;
 		glm::mat4 m_view;
+		float m_far;
+		evn_util::Frustum m_frustum;
 
 		// angle variables
 		double m_yaw;
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "evn_mesh.h"
+#include "util/frustum.h"
+
+namespace evn {
+    // what EndlessTerrain fills the world with
+    enum class ChunkType {
+        Heightfield,  // Terrain, one height per column
+        Volume        // VolumeTerrain, caves and overhangs
+    };
+
+    // how heightfield chunks hand their vertices to the gpu
+    enum class VertexSource {
+        Packed,     // a TerrainVertex buffer per chunk
+        Heightmap   // a storage buffer of samples, the shared grid is rebuilt in heightmap.vert
+    };
+
+    // where heightfield chunks get their vertex normals from
+    enum class NormalSource {
+        Analytic,          // the noise's own derivatives
+        CentralDifference  // differences of the drawn heights, with a ring of extra samples
+    };
+
+    // a piece of the world EndlessTerrain streams in and draws. it is
+    // built in two steps so the expensive one can run on a worker thread
+    class Chunk {
+    public:
+        virtual ~Chunk() = default;
+        // evaluates the noise and builds the vertices, on any thread
+        virtual void generate() = 0;
+        // hands what generate built to the gpu, on the thread recording frames.
+        // nothing is drawn before it has run
+        virtual void upload() = 0;
+        // device memory the chunk holds on its own, buffers shared with
+        // other chunks aren't counted. 0 before upload
+        virtual VkDeviceSize deviceBytes() const = 0;
+        // world space box around everything the chunk draws, valid once generated
+        virtual evn_util::Aabb bounds() const = 0;
+        // the layout is for chunks that push per draw constants
+        virtual void update(VkCommandBuffer& command_buffer, VkPipelineLayout& pipeline_layout) = 0;
+    };
+}
@@ -0,0 +1,38 @@
+#include "evn_chunk_residency.h"
+#include <algorithm>
+
+namespace evn {
+    ChunkResidency::ChunkResidency(Device& device, BufferPool& buffer_pool, VkDeviceSize budget)
+        : r_device(device), r_buffer_pool(buffer_pool), m_budget(budget), m_device_budget(~0ull), m_resident(0), m_frame(0)
+    {}
+
+    VkDeviceSize ChunkResidency::budget() const
+    {
+        return std::min(m_budget, m_device_budget);
+    }
+
+    VkDeviceSize ChunkResidency::excess() const
+    {
+        // evicted chunks' buffers wait out their frames uncounted, then the
+        // pool keeps no more than BufferPool::MAX_FREE_BYTES of them free
+        VkDeviceSize limit {budget()};
+        VkDeviceSize in_use {used()};
+        if (in_use <= limit)
+            return 0;
+        return in_use - (VkDeviceSize)(limit * LOW_WATER);
+    }
+
+    void ChunkResidency::nextFrame()
+    {
+        if (m_frame++ % BUDGET_INTERVAL != 0)
+            return;
+        VkDeviceSize device_budget {0};
+        VkDeviceSize device_usage {0};
+        if (!r_device.deviceLocalBudget(device_budget, device_usage))
+            return;
+        // the chunks and the pool can keep what they have and grow into a
+        // share of what nothing uses yet
+        VkDeviceSize room {device_budget > device_usage ? device_budget - device_usage : 0};
+        m_device_budget = used() + (VkDeviceSize)(room * DEVICE_SHARE);
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <algorithm>
+#include "evn_buffer.h"
+#include "evn_device.h"
+
+namespace evn {
+    // keeps count of the device memory the loaded chunks hold against a
+    // budget. EndlessTerrain evicts the least recently drawn chunks once
+    // the count goes over it, down to LOW_WATER of it so the next few
+    // chunks loaded don't each push another eviction. the free device
+    // local buffers the buffer pool keeps for new chunks count as well
+    class ChunkResidency {
+    public:
+        ChunkResidency(Device& device, BufferPool& buffer_pool, VkDeviceSize budget = DEFAULT_BUDGET);
+        inline void setBudget(VkDeviceSize budget) { m_budget = budget; }
+        // the set budget, or less when VK_EXT_memory_budget says the device
+        // doesn't have that much room left
+        VkDeviceSize budget() const;
+        inline VkDeviceSize resident() const { return m_resident; }
+        // what the chunks hold plus the free buffers the pool keeps for them.
+        // an evicted chunk's buffers only count again once they are free,
+        // so evicting brings the count down the same frame
+        inline VkDeviceSize used() const { return m_resident + r_buffer_pool.freeDeviceBytes(); }
+        // a chunk's buffers were uploaded or dropped
+        inline void add(VkDeviceSize bytes) { m_resident += bytes; }
+        inline void remove(VkDeviceSize bytes) { m_resident -= std::min(bytes, m_resident); }
+        // bytes to free now, 0 while under budget
+        VkDeviceSize excess() const;
+        // starts a frame, every BUDGET_INTERVAL frames it asks the driver again
+        void nextFrame();
+        inline uint64_t frame() const { return m_frame; }
+    public:
+        const static VkDeviceSize DEFAULT_BUDGET = 512ull << 20;
+        constexpr static float LOW_WATER = 0.9f;
+        // share of the device memory nothing uses yet that chunks may grow
+        // into, the rest is left to everything else
+        constexpr static float DEVICE_SHARE = 0.8f;
+        const static uint64_t BUDGET_INTERVAL = 60;
+    private:
+        Device& r_device;
+        BufferPool& r_buffer_pool;
+        VkDeviceSize m_budget;
+        // what the driver lets the chunks have, unlimited without the extension
+        VkDeviceSize m_device_budget;
+        VkDeviceSize m_resident;
+        uint64_t m_frame;
+    };
+}
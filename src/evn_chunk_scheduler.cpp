@@ -0,0 +1,65 @@
+#include "evn_chunk_scheduler.h"
+#include <algorithm>
+#include <iterator>
+
+namespace evn {
+    ChunkScheduler::ChunkScheduler(evn_util::MpmcQueue<GeneratedChunk>& generated, unsigned threads)
+        : r_generated(generated), m_workers(threads)
+    {}
+
+    void ChunkScheduler::request(glm::vec2 chunk_coord, int lod, std::shared_ptr<Chunk> chunk, float cost)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_requests.push_back({chunk_coord, lod, std::move(chunk), cost});
+            std::push_heap(m_requests.begin(), m_requests.end(), costlier);
+        }
+        // one job per request, but a job takes whichever request is cheapest
+        // when it starts. jobs left over from cancelled requests find nothing
+        m_workers.submit([this]() { generateNext(); });
+    }
+
+    void ChunkScheduler::reprioritise(const CostFunction& cost, std::vector<glm::vec2>& cancelled)
+    {
+        // cancelled chunks are destroyed outside the lock, they were never uploaded
+        std::vector<Request> dropped;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (Request& request : m_requests)
+                request.cost = cost(request.chunk_coord, request.lod);
+            auto kept {std::partition(m_requests.begin(), m_requests.end(),
+                [](const Request& request) { return request.cost >= 0.0f; })};
+            std::move(kept, m_requests.end(), std::back_inserter(dropped));
+            m_requests.erase(kept, m_requests.end());
+            std::make_heap(m_requests.begin(), m_requests.end(), costlier);
+        }
+        for (const Request& request : dropped)
+            cancelled.push_back(request.chunk_coord);
+    }
+
+    size_t ChunkScheduler::pending()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_requests.size();
+    }
+
+    void ChunkScheduler::generateNext()
+    {
+        Request request;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_requests.empty())
+                return;
+            std::pop_heap(m_requests.begin(), m_requests.end(), costlier);
+            request = std::move(m_requests.back());
+            m_requests.pop_back();
+        }
+        request.chunk->generate();
+        // the chunk is moved along so the render thread always holds the
+        // last reference, its buffers go back to the pool there
+        GeneratedChunk generated {request.chunk_coord, request.lod, std::move(request.chunk)};
+        // only full if the render thread stopped taking them
+        while (!r_generated.tryPush(std::move(generated)))
+            std::this_thread::yield();
+    }
+}
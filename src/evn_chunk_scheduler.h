@@ -0,0 +1,57 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <glm/glm.hpp>
+#include "evn_chunk.h"
+#include "util/mpmc_queue.h"
+#include "util/thread_pool.h"
+
+namespace evn {
+    // a chunk a worker has generated, waiting for the render thread to upload it
+    struct GeneratedChunk {
+        glm::vec2 chunk_coord;
+        int lod;
+        std::shared_ptr<Chunk> chunk;
+    };
+
+    // chunks waiting to be generated, handed to the workers cheapest first.
+    // the render thread scores them again as the camera moves and drops the
+    // ones that aren't wanted any more before a worker gets to them
+    class ChunkScheduler {
+    public:
+        // returns the cost of a waiting chunk, negative to cancel it
+        using CostFunction = std::function<float(glm::vec2 chunk_coord, int lod)>;
+
+        // finished chunks are pushed to generated, which has to outlive the scheduler
+        explicit ChunkScheduler(evn_util::MpmcQueue<GeneratedChunk>& generated, unsigned threads = 0);
+        // chunk is generated on a worker once nothing cheaper is waiting
+        void request(glm::vec2 chunk_coord, int lod, std::shared_ptr<Chunk> chunk, float cost);
+        // scores every waiting chunk again. the ones cost cancels are dropped
+        // and their coordinates added to cancelled
+        void reprioritise(const CostFunction& cost, std::vector<glm::vec2>& cancelled);
+        // chunks waiting for a worker
+        size_t pending();
+        inline unsigned threadCount() const { return m_workers.threadCount(); }
+    private:
+        struct Request {
+            glm::vec2 chunk_coord;
+            int lod;
+            std::shared_ptr<Chunk> chunk;
+            float cost;
+        };
+        // orders the heap so the cheapest request is on top
+        static bool costlier(const Request& a, const Request& b) { return a.cost > b.cost; }
+        // runs on a worker, generates the cheapest waiting chunk if any
+        void generateNext();
+    private:
+        evn_util::MpmcQueue<GeneratedChunk>& r_generated;
+        std::mutex m_mutex;
+        // a heap on cost
+        std::vector<Request> m_requests;
+        // last so its threads are joined before the requests are destroyed
+        evn_util::ThreadPool m_workers;
+    };
+}
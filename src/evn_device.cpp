@@ -40,7 +40,7 @@ namespace evn {
 	}
 
 	Device::Device(Window& window)
-		: m_physical_device(VK_NULL_HANDLE), r_window(window)
+		: m_physical_device(VK_NULL_HANDLE), r_window(window), m_memory_budget(false)
 	{
 		createInstance();
 		if (debug)
@@ -79,7 +79,9 @@ namespace evn {
 		app_info.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
 		app_info.pEngineName = "No Engine";
 		app_info.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-		app_info.apiVersion = VK_API_VERSION_1_0;
+		// 1.1 for vkGetPhysicalDeviceMemoryProperties2, the memory budget
+		// is chained onto it
+		app_info.apiVersion = VK_API_VERSION_1_1;
 
 		// create struct
 		VkInstanceCreateInfo create_info{};
@@ -170,9 +172,16 @@ namespace evn {
 		info.queueCreateInfoCount = static_cast<uint32_t>(create_info.size());
 		info.pEnabledFeatures = &feats;
 
-		// extensions
-		info.enabledExtensionCount = static_cast<uint32_t>(device_extensions.size());
-		info.ppEnabledExtensionNames = device_extensions.data();
+		// extensions, the memory budget only where the device has it
+		std::vector<const char*> extensions{ device_extensions };
+		VkPhysicalDeviceProperties props;
+		vkGetPhysicalDeviceProperties(m_physical_device, &props);
+		m_memory_budget = props.apiVersion >= VK_API_VERSION_1_1 &&
+			supportsExtension(m_physical_device, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+		if (m_memory_budget)
+			extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+		info.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+		info.ppEnabledExtensionNames = extensions.data();
 
 		// debug layers
 		if (debug) {
@@ -339,6 +348,40 @@ namespace evn {
 		return true;
 	}
 
+	bool Device::supportsExtension(const VkPhysicalDevice& device, const char* extension) const
+	{
+		uint32_t extension_count{ 0 };
+		vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, nullptr);
+		std::vector<VkExtensionProperties> props(extension_count);
+		vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, props.data());
+		for (const auto& available : props)
+			if (strcmp(available.extensionName, extension) == 0)
+				return true;
+		return false;
+	}
+
+	bool Device::deviceLocalBudget(VkDeviceSize& budget, VkDeviceSize& usage) const
+	{
+		if (!m_memory_budget)
+			return false;
+		VkPhysicalDeviceMemoryBudgetPropertiesEXT budget_props{};
+		budget_props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+		VkPhysicalDeviceMemoryProperties2 mem_props{};
+		mem_props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+		mem_props.pNext = &budget_props;
+		vkGetPhysicalDeviceMemoryProperties2(m_physical_device, &mem_props);
+
+		budget = 0;
+		usage = 0;
+		for (uint32_t i{ 0 }; i < mem_props.memoryProperties.memoryHeapCount; i++) {
+			if (!(mem_props.memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT))
+				continue;
+			budget += budget_props.heapBudget[i];
+			usage += budget_props.heapUsage[i];
+		}
+		return true;
+	}
+
 	uint32_t Device::findMemoryType(const uint32_t type_filter, VkMemoryPropertyFlags props)
 	{
 		VkPhysicalDeviceMemoryProperties mem_props;
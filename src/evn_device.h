@@ -53,6 +53,12 @@ namespace evn {
 		inline VkDevice& device() { return m_device; }
 		inline VkCommandPool& commandPool() { return m_command_pool; }
 		QueueFamilyIndices getQueueFamilies() const;
+		// whether VK_EXT_memory_budget is enabled
+		inline bool hasMemoryBudget() const { return m_memory_budget; }
+		// how much of the device local heaps the driver would let this
+		// process use right now and how much it already does, summed over
+		// the heaps. false when the device can't tell
+		bool deviceLocalBudget(VkDeviceSize& budget, VkDeviceSize& usage) const;
 		// helper methods
 		VkCommandBuffer beginSingleTimeCommands();
 		void endSingleTimeCommands(VkCommandBuffer& command_buffer);
@@ -74,6 +80,7 @@ namespace evn {
 		std::vector<const char*> getExtensions() const;
 		bool isDeviceSuitable(const VkPhysicalDevice& device) const;
 		bool checkDeviceExtensionSupport(const VkPhysicalDevice& device) const;
+		bool supportsExtension(const VkPhysicalDevice& device, const char* extension) const;
 		QueueFamilyIndices findQueueFamilies(const VkPhysicalDevice& device) const;
 		SwapchainSupportDetails querySwapchainSupport(const VkPhysicalDevice& device) const;
 		// debug methods
@@ -91,6 +98,7 @@ namespace evn {
 		VkSurfaceKHR m_surface;
 		VkCommandPool m_command_pool;
 		Window& r_window;
+		bool m_memory_budget;
 		
 		// debug
 		VkDebugUtilsMessengerEXT m_debug_messenger;
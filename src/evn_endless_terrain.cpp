@@ -1,23 +1,91 @@
 #include "evn_endless_terrain.h"
+#include <algorithm>
+#include <cstdlib>
 
 namespace evn {
-    EndlessTerrain::EndlessTerrain(Device& device, Camera& camera)
-        : r_device(device), r_camera(camera), 
+    EndlessTerrain::EndlessTerrain(Device& device, BufferPool& buffer_pool, Camera& camera,
+        evn_util::NoiseType noise_type,
+        ChunkType chunk_type, VertexSource vertex_source, NormalSource normal_source)
+        : r_device(device), r_buffer_pool(buffer_pool), r_camera(camera), m_chunk_type(chunk_type),
+        m_vertex_source(vertex_source), m_normal_source(normal_source), m_heightmap_pool(device),
+        m_residency(device, buffer_pool),
+        m_volume_noise(chunk_type == ChunkType::Volume ? VolumeTerrain::createNoise() : nullptr),
+        m_render_dist(chunk_type == ChunkType::Volume ? VOLUME_RENDER_DIST : HEIGHTFIELD_RENDER_DIST),
         m_chunk_size(Terrain::MESH_HEIGHT - 1), 
-        m_no_visible_chunks((int)(m_render_dist / m_chunk_size))
+        m_no_visible_chunks((int)(m_render_dist / m_chunk_size)),
+        m_generated(GENERATED_CAPACITY), m_scheduled_pos(0.0f), m_scheduled_dir(0.0f),
+        m_scheduler(m_generated)
     {
+        if (m_chunk_type != ChunkType::Heightfield)
+            return;
+        for (int lod{0}; lod < Terrain::LOD_LEVELS; lod++) {
+            m_graphs.push_back(Terrain::createGraph(noise_type, Terrain::lodOctaves(noise_type, lod)));
+            m_grid_indices.push_back(Terrain::createGridIndices(buffer_pool, lod));
+        }
     }
 
-    void EndlessTerrain::update(VkCommandBuffer& command_buffer)
+    void EndlessTerrain::update(VkCommandBuffer& command_buffer, VkPipelineLayout& pipeline_layout)
     {
+        m_heightmap_pool.nextFrame();
+        m_residency.nextFrame();
+        uploadGeneratedChunks();
         glm::vec2 viewer_pos {r_camera.m_pos.x, r_camera.m_pos.z};
-        updateVisibleChunks(viewer_pos);
-        // render visible chunks
-        for (auto& chunk : m_visible_chunks) 
-            chunk->update(command_buffer);
+        glm::vec2 viewer_dir {r_camera.front().x, r_camera.front().z};
+        // looking straight down every direction is as good as another
+        viewer_dir = glm::length(viewer_dir) > 1e-3f ? glm::normalize(viewer_dir) : glm::vec2{0.0f};
+        if (viewer_pos != m_scheduled_pos || viewer_dir != m_scheduled_dir)
+            rescheduleChunks(viewer_pos, viewer_dir);
+        updateVisibleChunks(viewer_pos, viewer_dir);
+        evictChunks(viewer_pos);
+        // render visible chunks, skipping the ones outside the view frustum.
+        // they still count as drawn, so turning around doesn't evict them
+        const evn_util::Frustum& frustum {r_camera.frustum()};
+        for (Chunk* chunk : m_visible_chunks)
+            if (frustum.intersects(chunk->bounds()))
+                chunk->update(command_buffer, pipeline_layout);
+    }
+
+    void EndlessTerrain::uploadGeneratedChunks()
+    {
+        GeneratedChunk generated;
+        while (m_generated.tryPop(generated)) {
+            // the chunk it replaces keeps its buffers and set until frames
+            // in flight are done with them
+            ChunkEntry& entry {m_chunks[chunkKey(generated.chunk_coord)]};
+            generated.chunk->upload();
+            m_residency.remove(entry.bytes);
+            entry.bytes = generated.chunk->deviceBytes();
+            m_residency.add(entry.bytes);
+            entry.chunk = std::move(generated.chunk);
+            entry.lod = generated.lod;
+            entry.pending_lod = -1;
+        }
     }
 
-    void EndlessTerrain::updateVisibleChunks(glm::vec2 viewer_pos)
+    void EndlessTerrain::rescheduleChunks(glm::vec2 viewer_pos, glm::vec2 viewer_dir)
+    {
+        m_scheduled_pos = viewer_pos;
+        m_scheduled_dir = viewer_dir;
+        m_cancelled.clear();
+        m_scheduler.reprioritise([&](glm::vec2 chunk_coord, int lod) {
+            // a rebuild the viewer has moved back out of is dropped too, the
+            // chunk is requested again at the right level if it still needs one
+            const ChunkEntry& entry {*m_chunks.find(chunkKey(chunk_coord))};
+            if (!inView(viewer_pos, chunk_coord)
+                || chooseLod(chunkDistance(viewer_pos, chunk_coord), entry.lod) != lod)
+                return -1.0f;
+            return chunkCost(viewer_pos, viewer_dir, chunk_coord);
+        }, m_cancelled);
+        for (glm::vec2 chunk_coord : m_cancelled) {
+            ChunkEntry& entry {*m_chunks.find(chunkKey(chunk_coord))};
+            entry.pending_lod = -1;
+            // nothing was ever loaded there
+            if (!entry.chunk)
+                m_chunks.erase(chunkKey(chunk_coord));
+        }
+    }
+
+    void EndlessTerrain::updateVisibleChunks(glm::vec2 viewer_pos, glm::vec2 viewer_dir)
     {
         // clear visible chunks
         m_visible_chunks.clear();
@@ -28,24 +96,149 @@ namespace evn {
         for (int y_offset = -m_no_visible_chunks; y_offset <= m_no_visible_chunks; y_offset++) {
             for (int x_offset = -m_no_visible_chunks; x_offset <= m_no_visible_chunks; x_offset++) {
                 glm::vec2 viewed_chunk_coord {curr_x + x_offset, curr_y + y_offset};
-                
-                if (m_chunks.find(viewed_chunk_coord) != m_chunks.end()) {
-                    m_visible_chunks.insert(m_chunks[viewed_chunk_coord]);
-                } else {
-                    m_chunks[viewed_chunk_coord] = std::make_shared<Terrain>(r_device,
-                    viewed_chunk_coord.x * (m_chunk_size), viewed_chunk_coord.y * (m_chunk_size));
-
-                    m_visible_chunks.insert(m_chunks[viewed_chunk_coord]);
+                ChunkEntry& entry {m_chunks[chunkKey(viewed_chunk_coord)]};
+
+                // build the chunk, or rebuild it once it has moved far
+                // enough to want another level of detail. the one there is
+                // drawn until the new one is uploaded, a missing one is
+                // left out
+                int lod {chooseLod(chunkDistance(viewer_pos, viewed_chunk_coord), entry.lod)};
+                if (lod != entry.lod && entry.pending_lod < 0)
+                    requestChunk(viewed_chunk_coord, entry, lod,
+                        chunkCost(viewer_pos, viewer_dir, viewed_chunk_coord));
+                if (entry.chunk) {
+                    m_visible_chunks.push_back(entry.chunk.get());
+                    entry.last_drawn = m_residency.frame();
                 }
             }
         }
+        if (m_chunk_type == ChunkType::Heightfield)
+            stitchVisibleChunks(curr_x, curr_y);
+    }
+
+    void EndlessTerrain::evictChunks(glm::vec2 viewer_pos)
+    {
+        VkDeviceSize excess {m_residency.excess()};
+        if (excess == 0)
+            return;
+
+        // chunks being rebuilt are left alone, their build would have
+        // nowhere to go
+        m_evictable.clear();
+        for (const auto& slot : m_chunks) {
+            const ChunkEntry& entry {slot.value};
+            if (entry.chunk && entry.pending_lod < 0 && !inView(viewer_pos, chunkCoord(slot.key), EVICT_MARGIN))
+                m_evictable.emplace_back(entry.last_drawn, slot.key);
+        }
+        std::sort(m_evictable.begin(), m_evictable.end(), [](const auto& a, const auto& b) {
+            return a.first < b.first;
+        });
+
+        // the buffers and sets go back to their pools once frames in flight are done
+        VkDeviceSize freed {0};
+        for (const auto& [last_drawn, key] : m_evictable) {
+            if (freed >= excess)
+                break;
+            VkDeviceSize bytes {m_chunks.find(key)->bytes};
+            freed += bytes;
+            m_residency.remove(bytes);
+            m_chunks.erase(key);
+        }
+    }
+
+    void EndlessTerrain::stitchVisibleChunks(int curr_x, int curr_y)
+    {
+        // chunks past the visible square aren't drawn, so there is nothing
+        // to match across to, nor across chunks still being built
+        auto lod_at = [&](int x, int y, int own_lod) {
+            if (std::abs(x - curr_x) > m_no_visible_chunks || std::abs(y - curr_y) > m_no_visible_chunks)
+                return own_lod;
+            const ChunkEntry* entry {m_chunks.find(evn_util::packCoords(x, y))};
+            return entry && entry->chunk ? entry->lod : own_lod;
+        };
+        for (int y = curr_y - m_no_visible_chunks; y <= curr_y + m_no_visible_chunks; y++) {
+            for (int x = curr_x - m_no_visible_chunks; x <= curr_x + m_no_visible_chunks; x++) {
+                ChunkEntry* entry {m_chunks.find(evn_util::packCoords(x, y))};
+                if (!entry || !entry->chunk)
+                    continue;
+                Terrain::EdgeLods neighbour_lods;
+                neighbour_lods[Terrain::EDGE_LEFT] = lod_at(x - 1, y, entry->lod);
+                neighbour_lods[Terrain::EDGE_RIGHT] = lod_at(x + 1, y, entry->lod);
+                neighbour_lods[Terrain::EDGE_TOP] = lod_at(x, y - 1, entry->lod);
+                neighbour_lods[Terrain::EDGE_BOTTOM] = lod_at(x, y + 1, entry->lod);
+                static_cast<Terrain*>(entry->chunk.get())->setEdgeLods(neighbour_lods);
+            }
+        }
     }
     
-    bool CompareVec2::operator()(const glm::vec2& op1, const glm::vec2& op2) const
+    void EndlessTerrain::requestChunk(glm::vec2 chunk_coord, ChunkEntry& entry, int lod, float cost)
+    {
+        entry.pending_lod = lod;
+        m_scheduler.request(chunk_coord, lod, createChunk(chunk_coord, lod), cost);
+    }
+
+    std::shared_ptr<Chunk> EndlessTerrain::createChunk(glm::vec2 chunk_coord, int lod)
+    {
+        int x_offset {(int)(chunk_coord.x * m_chunk_size)};
+        int y_offset {(int)(chunk_coord.y * m_chunk_size)};
+        if (m_chunk_type == ChunkType::Volume)
+            return std::make_shared<VolumeTerrain>(r_buffer_pool, m_volume_noise, x_offset, y_offset);
+        return std::make_shared<Terrain>(r_buffer_pool, m_graphs[lod], m_grid_indices[lod],
+            m_vertex_source == VertexSource::Heightmap ? &m_heightmap_pool : nullptr, m_normal_source,
+            lod, x_offset, y_offset);
+    }
+
+    float EndlessTerrain::chunkDistance(glm::vec2 viewer_pos, glm::vec2 chunk_coord) const
+    {
+        glm::vec2 corner {chunk_coord * (float)m_chunk_size};
+        glm::vec2 closest {glm::clamp(viewer_pos, corner, corner + (float)m_chunk_size)};
+        return glm::length(viewer_pos - closest);
+    }
+
+    float EndlessTerrain::chunkCost(glm::vec2 viewer_pos, glm::vec2 viewer_dir, glm::vec2 chunk_coord) const
+    {
+        // the chunk under the viewer costs nothing whichever way it looks
+        glm::vec2 to_chunk {(chunk_coord + 0.5f) * (float)m_chunk_size - viewer_pos};
+        float facing {1.0f};
+        if (glm::length(to_chunk) > 0.0f && viewer_dir != glm::vec2{0.0f})
+            facing = glm::dot(glm::normalize(to_chunk), viewer_dir);
+        return chunkDistance(viewer_pos, chunk_coord) * (1.0f + FACING_WEIGHT * 0.5f * (1.0f - facing));
+    }
+
+    bool EndlessTerrain::inView(glm::vec2 viewer_pos, glm::vec2 chunk_coord, int margin) const
+    {
+        int curr_x {(int)(viewer_pos.x / m_chunk_size)};
+        int curr_y {(int)(viewer_pos.y / m_chunk_size)};
+        return std::abs((int)chunk_coord.x - curr_x) <= m_no_visible_chunks + margin
+            && std::abs((int)chunk_coord.y - curr_y) <= m_no_visible_chunks + margin;
+    }
+
+    int EndlessTerrain::chooseLod(float distance, int current) const
+    {
+        // volume chunks only have the one level
+        if (m_chunk_type != ChunkType::Heightfield)
+            return 0;
+        // level lod ends LOD_DISTANCE * 2^lod away. a new chunk takes the
+        // level it is in, a loaded one only moves past the margin
+        float margin {current < 0 ? 0.0f : LOD_HYSTERESIS};
+        int lod {std::max(current, 0)};
+        while (lod + 1 < Terrain::LOD_LEVELS && distance > LOD_DISTANCE * (float)(1 << lod) + margin)
+            lod++;
+        while (lod > 0 && distance < LOD_DISTANCE * (float)(1 << (lod - 1)) - margin)
+            lod--;
+        return lod;
+    }
+
+    uint64_t EndlessTerrain::chunkKey(glm::vec2 chunk_coord)
+    {
+        return evn_util::packCoords((int32_t)chunk_coord.x, (int32_t)chunk_coord.y);
+    }
+
+    glm::vec2 EndlessTerrain::chunkCoord(uint64_t key)
     {
-        if (op1.x < op2.x) return true;
-        if (op1.x > op2.x) return false;
-        return (op1.y < op2.y);
+        int32_t x, y;
+        evn_util::unpackCoords(key, x, y);
+        return {(float)x, (float)y};
     }
 
 }
@@ -1,31 +1,118 @@
 #pragma once
 
-#include <set>
-#include <map>
 #include <memory>
 #include "evn_terrain.h"
+#include "evn_volume_terrain.h"
 #include "evn_camera.h"
+#include "evn_chunk_scheduler.h"
+#include "evn_chunk_residency.h"
+#include "util/flat_map.h"
 namespace evn {
-    // Wrapper class for glm::vec2 to compare the
-    // two vectors in use with the std::map.find()
-    struct CompareVec2 {
-        bool operator()(const glm::vec2&, const glm::vec2&) const;
+    // a loaded chunk and the level of detail it was built at
+    struct ChunkEntry {
+        // null until the first build is uploaded
+        std::shared_ptr<Chunk> chunk;
+        int lod {-1};
+        // level being built on a worker, -1 when there is none
+        int pending_lod {-1};
+        // frame the chunk was last drawn in and the device memory it holds
+        uint64_t last_drawn {0};
+        VkDeviceSize bytes {0};
     };
 
-
     class EndlessTerrain {
     public:
-        EndlessTerrain(Device& device, Camera& camera);
-        void update(VkCommandBuffer& command_buffer);
+        // buffer_pool has to outlive the terrain, its chunks hand their
+        // buffers back to it
+        EndlessTerrain(Device& device, BufferPool& buffer_pool, Camera& camera,
+            evn_util::NoiseType noise_type=evn_util::NoiseType::Perlin,
+            ChunkType chunk_type=ChunkType::Heightfield,
+            VertexSource vertex_source=VertexSource::Heightmap,
+            NormalSource normal_source=NormalSource::CentralDifference);
+        void update(VkCommandBuffer& command_buffer, VkPipelineLayout& pipeline_layout);
+        // heightfield chunks draw with TerrainVertex, volume chunks with Vertex
+        inline ChunkType chunkType() const { return m_chunk_type; }
+        inline VertexSource vertexSource() const { return m_vertex_source; }
+        inline float renderDistance() const { return m_render_dist; }
+        // set layout of the heightmap storage buffers, part of every pipeline layout
+        inline VkDescriptorSetLayout& heightmapLayout() { return m_heightmap_pool.layout(); }
+        // device memory of the loaded chunks and the budget it is held to
+        inline ChunkResidency& residency() { return m_residency; }
+    public:
+        // heightfield chunks drop a level of detail every time the distance
+        // to them doubles past LOD_DISTANCE, and only switch once they are
+        // LOD_HYSTERESIS past the boundary so they don't flicker on it
+        constexpr static float LOD_DISTANCE = 240.0f;
+        constexpr static float LOD_HYSTERESIS = 32.0f;
+        constexpr static float HEIGHTFIELD_RENDER_DIST = 1440.0f;
+        constexpr static float VOLUME_RENDER_DIST = 450.0f;
+        // chunks finished but not uploaded yet, far more than can be in view
+        const static size_t GENERATED_CAPACITY = 1024;
+        // chunks this many past the drawn square are kept however long ago
+        // they were drawn, so turning back and forth at the edge doesn't
+        // evict and rebuild them
+        const static int EVICT_MARGIN = 1;
+        // how much further away a chunk straight behind the camera counts
+        // as than one straight ahead when picking what to generate next
+        constexpr static float FACING_WEIGHT = 2.0f;
     private:
-        void updateVisibleChunks(glm::vec2 viewer_pos);
+        // uploads every chunk the workers have finished since the last frame
+        void uploadGeneratedChunks();
+        // scores the waiting chunks for where the camera is now, cancelling
+        // the ones out of view or no longer wanted at their level
+        void rescheduleChunks(glm::vec2 viewer_pos, glm::vec2 viewer_dir);
+        void updateVisibleChunks(glm::vec2 viewer_pos, glm::vec2 viewer_dir);
+        // drops the least recently drawn chunks until they fit the budget
+        void evictChunks(glm::vec2 viewer_pos);
+        // queue a build of the chunk at lod on the workers
+        void requestChunk(glm::vec2 chunk_coord, ChunkEntry& entry, int lod, float cost);
+        std::shared_ptr<Chunk> createChunk(glm::vec2 chunk_coord, int lod);
+        // distance from the viewer to the closest point of a chunk
+        float chunkDistance(glm::vec2 viewer_pos, glm::vec2 chunk_coord) const;
+        // generation order, the distance stretched for chunks away from
+        // where the viewer looks. viewer_dir is unit length or zero
+        float chunkCost(glm::vec2 viewer_pos, glm::vec2 viewer_dir, glm::vec2 chunk_coord) const;
+        // chunk coordinates as a key of m_chunks, and back
+        static uint64_t chunkKey(glm::vec2 chunk_coord);
+        static glm::vec2 chunkCoord(uint64_t key);
+        // whether a chunk is inside the square drawn around the viewer's
+        // chunk, grown by margin chunks on every side
+        bool inView(glm::vec2 viewer_pos, glm::vec2 chunk_coord, int margin = 0) const;
+        // level of detail at distance for a chunk at current, or -1 for a new one
+        int chooseLod(float distance, int current) const;
+        // stitch each visible heightfield chunk to the levels of the ones around it
+        void stitchVisibleChunks(int curr_x, int curr_y);
     private:
         Device& r_device;
+        BufferPool& r_buffer_pool;
         Camera& r_camera;
-        std::set<std::shared_ptr<Terrain>> m_visible_chunks;
-        std::map<glm::vec2, std::shared_ptr<Terrain>, CompareVec2> m_chunks;
-        const float m_render_dist = 450;
+        ChunkType m_chunk_type;
+        VertexSource m_vertex_source;
+        NormalSource m_normal_source;
+        // must outlive the chunks that hold sets from it
+        HeightmapPool m_heightmap_pool;
+        ChunkResidency m_residency;
+        // per level of detail, shared by every heightfield chunk at that level
+        std::vector<std::shared_ptr<const evn_util::NoiseGraph>> m_graphs;
+        std::vector<std::shared_ptr<const Terrain::GridIndices>> m_grid_indices;
+        // only created for volume chunks
+        std::shared_ptr<evn_util::PerlinNoise> m_volume_noise;
+        // drawn this frame, owned by their entries in m_chunks. cleared
+        // rather than freed every frame so it stops allocating once the
+        // view has been filled
+        std::vector<Chunk*> m_visible_chunks;
+        evn_util::FlatMap<ChunkEntry> m_chunks;
+        float m_render_dist;
         int m_chunk_size;
         int m_no_visible_chunks;
+        evn_util::MpmcQueue<GeneratedChunk> m_generated;
+        // where the waiting chunks were last scored from
+        glm::vec2 m_scheduled_pos;
+        glm::vec2 m_scheduled_dir;
+        std::vector<glm::vec2> m_cancelled;
+        // (last drawn, key) of the chunks eviction may pick from
+        std::vector<std::pair<uint64_t, uint64_t>> m_evictable;
+        // last so its workers are joined before anything a job uses is destroyed
+        ChunkScheduler m_scheduler;
     };
-}
\ No newline at end of file
+}
@@ -0,0 +1,160 @@
+#include "evn_heightmap.h"
+#include <algorithm>
+#include "evn_swapchain.h"
+
+namespace evn {
+	HeightmapPool::HeightmapPool(Device& device)
+		: r_device(device), m_layout(VK_NULL_HANDLE), m_frame(0)
+	{
+		createDescriptorSetLayout();
+	}
+
+	HeightmapPool::~HeightmapPool()
+	{
+		for (auto& pool : m_pools)
+			vkDestroyDescriptorPool(r_device.device(), pool, nullptr);
+		vkDestroyDescriptorSetLayout(r_device.device(), m_layout, nullptr);
+	}
+
+	VkDescriptorSet HeightmapPool::allocate(VkBuffer& buffer, VkDescriptorPool& pool)
+	{
+		VkDescriptorSetAllocateInfo alloc_info{};
+		alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		alloc_info.descriptorSetCount = 1;
+		alloc_info.pSetLayouts = &m_layout;
+
+		// the newest pool is the one most likely to have room
+		VkDescriptorSet set{ VK_NULL_HANDLE };
+		for (auto it{ m_pools.rbegin() }; it != m_pools.rend() && set == VK_NULL_HANDLE; it++) {
+			alloc_info.descriptorPool = *it;
+			if (vkAllocateDescriptorSets(r_device.device(), &alloc_info, &set) == VK_SUCCESS)
+				pool = *it;
+			else
+				set = VK_NULL_HANDLE;
+		}
+		if (set == VK_NULL_HANDLE) {
+			m_pools.push_back(createDescriptorPool());
+			alloc_info.descriptorPool = m_pools.back();
+			if (vkAllocateDescriptorSets(r_device.device(), &alloc_info, &set) != VK_SUCCESS)
+				throw std::runtime_error("Failed to allocate heightmap descriptor set");
+			pool = m_pools.back();
+		}
+
+		VkDescriptorBufferInfo buffer_info{};
+		buffer_info.buffer = buffer;
+		buffer_info.offset = 0;
+		buffer_info.range = VK_WHOLE_SIZE;
+
+		VkWriteDescriptorSet write{};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = set;
+		write.dstBinding = 0;
+		write.dstArrayElement = 0;
+		write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		write.descriptorCount = 1;
+		write.pBufferInfo = &buffer_info;
+
+		vkUpdateDescriptorSets(r_device.device(), 1, &write, 0, nullptr);
+		return set;
+	}
+
+	void HeightmapPool::free(VkDescriptorSet set, VkDescriptorPool pool)
+	{
+		m_released.push_back({ m_frame, set, pool });
+	}
+
+	void HeightmapPool::nextFrame()
+	{
+		m_frame++;
+		auto done{ std::partition(m_released.begin(), m_released.end(),
+			[&](const Released& released) { return released.frame + MAX_FRAMES_IN_FLIGHT > m_frame; }) };
+		for (auto it{ done }; it != m_released.end(); it++)
+			vkFreeDescriptorSets(r_device.device(), it->pool, 1, &it->set);
+		m_released.erase(done, m_released.end());
+	}
+
+	void HeightmapPool::createDescriptorSetLayout()
+	{
+		VkDescriptorSetLayoutBinding sample_binding{};
+		sample_binding.binding = 0;
+		sample_binding.descriptorCount = 1;
+		sample_binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		sample_binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+		sample_binding.pImmutableSamplers = nullptr;
+
+		VkDescriptorSetLayoutCreateInfo layout_info{};
+		layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layout_info.bindingCount = 1;
+		layout_info.pBindings = &sample_binding;
+
+		if (vkCreateDescriptorSetLayout(r_device.device(), &layout_info, nullptr, &m_layout)
+			!= VK_SUCCESS)
+			throw std::runtime_error("Failed to create heightmap descriptor set layout");
+	}
+
+	VkDescriptorPool HeightmapPool::createDescriptorPool()
+	{
+		VkDescriptorPoolSize pool_size{};
+		pool_size.descriptorCount = SETS_PER_POOL;
+		pool_size.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+
+		// chunks free their own set when they are destroyed
+		VkDescriptorPoolCreateInfo create_info{};
+		create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		create_info.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+		create_info.pPoolSizes = &pool_size;
+		create_info.poolSizeCount = 1;
+		create_info.maxSets = SETS_PER_POOL;
+
+		VkDescriptorPool pool;
+		if (vkCreateDescriptorPool(r_device.device(), &create_info, nullptr, &pool) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create heightmap descriptor pool");
+		return pool;
+	}
+
+	Heightmap::Heightmap(BufferPool& buffer_pool, HeightmapPool& pool, const TerrainSample* samples,
+		size_t sample_count, std::shared_ptr<IndexBuffer> indices)
+		: r_buffer_pool(buffer_pool), r_pool(pool),
+		m_sample_buffer(buffer_pool.upload(samples, sizeof(TerrainSample) * sample_count,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT)),
+		m_index_buffer(std::move(indices)),
+		m_descriptor_set(VK_NULL_HANDLE), m_descriptor_pool(VK_NULL_HANDLE)
+	{
+		m_descriptor_set = r_pool.allocate(m_sample_buffer->getBuffer(), m_descriptor_pool);
+	}
+
+	Heightmap::Heightmap(Heightmap&& other) noexcept
+		: r_buffer_pool(other.r_buffer_pool), r_pool(other.r_pool),
+		m_sample_buffer(std::move(other.m_sample_buffer)),
+		m_index_buffer(std::move(other.m_index_buffer)),
+		m_descriptor_set(other.m_descriptor_set), m_descriptor_pool(other.m_descriptor_pool)
+	{
+		other.m_descriptor_set = VK_NULL_HANDLE;
+		other.m_descriptor_pool = VK_NULL_HANDLE;
+	}
+
+	Heightmap::~Heightmap()
+	{
+		// both pools hold on to them until frames in flight are done
+		if (m_descriptor_set != VK_NULL_HANDLE)
+			r_pool.free(m_descriptor_set, m_descriptor_pool);
+		r_buffer_pool.release(std::move(m_sample_buffer));
+	}
+
+	void Heightmap::bind(VkCommandBuffer& command_buffer, VkPipelineLayout& pipeline_layout)
+	{
+		vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout,
+			HeightmapPool::SET_INDEX, 1, &m_descriptor_set, 0, nullptr);
+		m_index_buffer->bind(command_buffer);
+	}
+
+	void Heightmap::draw(VkCommandBuffer& command_buffer)
+	{
+		vkCmdDrawIndexed(command_buffer, m_index_buffer->count(), 1, 0, 0, 0);
+	}
+
+	void Heightmap::draw(VkCommandBuffer& command_buffer, const IndexRange& range)
+	{
+		vkCmdDrawIndexed(command_buffer, range.count, 1, range.first, 0, 0);
+	}
+}
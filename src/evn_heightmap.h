@@ -0,0 +1,70 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include "evn_device.h"
+#include "evn_buffer.h"
+#include "evn_mesh.h"
+
+namespace evn {
+	// descriptor set layout of a Heightmap's storage buffer, and the pools
+	// its sets come from. pools are added as chunks stream in
+	class HeightmapPool {
+	public:
+		HeightmapPool(Device& device);
+		~HeightmapPool();
+		HeightmapPool(const HeightmapPool&) = delete;
+		HeightmapPool& operator=(const HeightmapPool&) = delete;
+		inline VkDescriptorSetLayout& layout() { return m_layout; }
+		// a set pointing at buffer, pool is where it has to be freed
+		VkDescriptorSet allocate(VkBuffer& buffer, VkDescriptorPool& pool);
+		// frames in flight may still bind the set, it is freed
+		// MAX_FRAMES_IN_FLIGHT frames later
+		void free(VkDescriptorSet set, VkDescriptorPool pool);
+		// called once a frame, before recording it
+		void nextFrame();
+	public:
+		// bound after the camera's set
+		const static uint32_t SET_INDEX = 1;
+	private:
+		void createDescriptorSetLayout();
+		VkDescriptorPool createDescriptorPool();
+	private:
+		struct Released {
+			uint64_t frame;
+			VkDescriptorSet set;
+			VkDescriptorPool pool;
+		};
+		const static uint32_t SETS_PER_POOL = 64;
+		Device& r_device;
+		VkDescriptorSetLayout m_layout;
+		std::vector<VkDescriptorPool> m_pools;
+		std::vector<Released> m_released;
+		uint64_t m_frame;
+	};
+
+	// a chunk drawn without a vertex buffer. its samples live in a storage
+	// buffer and heightmap.vert rebuilds each vertex from gl_VertexIndex,
+	// the shared grid indices and the push constants
+	class Heightmap {
+	public:
+		// the samples are copied to the gpu before this returns
+		Heightmap(BufferPool& buffer_pool, HeightmapPool& pool, const TerrainSample* samples,
+			size_t sample_count, std::shared_ptr<IndexBuffer> indices);
+		~Heightmap();
+		// takes the other's buffer and set, it is left with neither
+		Heightmap(Heightmap&& other) noexcept;
+		Heightmap(const Heightmap&) = delete;
+		Heightmap& operator=(const Heightmap&) = delete;
+		void bind(VkCommandBuffer& command_buffer, VkPipelineLayout& pipeline_layout);
+		void draw(VkCommandBuffer& command_buffer);
+		void draw(VkCommandBuffer& command_buffer, const IndexRange& range);
+		inline VkDeviceSize sampleBytes() const { return m_sample_buffer->size(); }
+	private:
+		BufferPool& r_buffer_pool;
+		HeightmapPool& r_pool;
+		std::unique_ptr<Buffer> m_sample_buffer;
+		std::shared_ptr<IndexBuffer> m_index_buffer;
+		VkDescriptorSet m_descriptor_set;
+		VkDescriptorPool m_descriptor_pool;
+	};
+}
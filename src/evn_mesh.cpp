@@ -1,61 +1,134 @@
 #include "evn_mesh.h"
+#include <cstring>
+#include <cmath>
+#include "util/mesh_optimizer.h"
 
 namespace evn{
-	Mesh::Mesh(Device& device, Data& data)
-		:r_device(device), m_index_count(data.indices.size()), m_vertex_count(data.vertices.size())
+	TerrainSample TerrainSample::pack(float height, const glm::vec3& normal)
 	{
-		createVertexBuffer(data.vertices);
-		createIndexBuffer(data.indices);
+		glm::vec2 octahedral{ encodeNormal(normal) };
+		TerrainSample sample{};
+		sample.height = toHalf(height);
+		sample.normal[0] = (int8_t)std::lround(octahedral.x * 127.0f);
+		sample.normal[1] = (int8_t)std::lround(octahedral.y * 127.0f);
+		return sample;
 	}
-	Mesh::~Mesh()
-	{}
 
-	void Mesh::bind(VkCommandBuffer& command_buffer)
+	TerrainVertex TerrainVertex::pack(int x, int z, const TerrainSample& sample)
 	{
-		VkBuffer buffers[] = { m_vertex_buffer->getBuffer() };
-		VkDeviceSize offsets[] = { 0 };
-		vkCmdBindVertexBuffers(command_buffer, 0, 1, buffers, offsets);
+		return { (uint16_t)x, (uint16_t)z, sample.height, { sample.normal[0], sample.normal[1] } };
+	}
 
-		vkCmdBindIndexBuffer(command_buffer, m_index_buffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+	glm::vec2 TerrainSample::encodeNormal(const glm::vec3& normal)
+	{
+		float l1{ std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z) };
+		glm::vec2 p{ normal.x / l1, normal.z / l1 };
+		// fold the upward hemisphere over the diagonals
+		if (normal.y > 0) {
+			glm::vec2 folded{ 1.0f - std::fabs(p.y), 1.0f - std::fabs(p.x) };
+			p.x = p.x < 0 ? -folded.x : folded.x;
+			p.y = p.y < 0 ? -folded.y : folded.y;
+		}
+		return p;
 	}
 
-	void Mesh::draw(VkCommandBuffer& command_buffer)
+	uint16_t TerrainSample::toHalf(float value)
 	{
-		vkCmdDrawIndexed(command_buffer, m_index_count, 1, 0, 0, 0);
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		uint16_t sign{ (uint16_t)((bits >> 16) & 0x8000) };
+		uint32_t abs_bits{ bits & 0x7fffffff };
+
+		// too big for a half, or nan
+		if (abs_bits >= 0x47800000)
+			return sign | (abs_bits > 0x7f800000 ? 0x7e00 : 0x7c00);
+		// too small even for a denormal half
+		if (abs_bits < 0x33000000)
+			return sign;
+
+		int exponent{ (int)(abs_bits >> 23) - 127 + 15 };
+		uint32_t mantissa{ (abs_bits & 0x7fffff) | 0x800000 };
+		int shift{ exponent > 0 ? 13 : 14 - exponent };
+		uint32_t half{ exponent > 0 ? ((uint32_t)exponent << 10) | ((mantissa >> shift) & 0x3ff)
+			: mantissa >> shift };
+		// round to nearest even, a carry into the exponent is still correct
+		uint32_t rest{ mantissa & ((1u << shift) - 1) };
+		uint32_t halfway{ 1u << (shift - 1) };
+		if (rest > halfway || (rest == halfway && (half & 1)))
+			half++;
+		return sign | (uint16_t)half;
 	}
 
-	void Mesh::createVertexBuffer(std::vector<Vertex>& vertices)
+	void Data::optimize()
 	{
-		VkDeviceSize buffer_size{ sizeof(vertices[0]) * vertices.size() };
-		Buffer staging(r_device, buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		evn_util::optimizeVertexCache(indices.data(), indices.size(), vertices.size());
+		evn_util::remapVertices(vertices,
+			evn_util::optimizeVertexFetch(indices.data(), indices.size(), vertices.size()));
+	}
 
-		// move memory to device
-		staging.map();
-		staging.writeToBuffer((void*)vertices.data());
+	IndexBuffer::IndexBuffer(BufferPool& pool, std::vector<uint16_t>& indices)
+		:r_pool(pool), m_buffer(pool.upload(indices.data(), sizeof(indices[0]) * indices.size(),
+			VK_BUFFER_USAGE_INDEX_BUFFER_BIT)),
+		m_count(indices.size()), m_type(VK_INDEX_TYPE_UINT16)
+	{}
+
+	IndexBuffer::IndexBuffer(BufferPool& pool, std::vector<uint32_t>& indices)
+		:r_pool(pool), m_buffer(pool.upload(indices.data(), sizeof(indices[0]) * indices.size(),
+			VK_BUFFER_USAGE_INDEX_BUFFER_BIT)),
+		m_count(indices.size()), m_type(VK_INDEX_TYPE_UINT32)
+	{}
 
-		// move staging to vertex buffer
-		m_vertex_buffer = std::make_unique<Buffer>(r_device, buffer_size,
-			VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		m_vertex_buffer->copyBuffer(staging.getBuffer(), buffer_size);
+	IndexBuffer::~IndexBuffer()
+	{
+		r_pool.release(std::move(m_buffer));
 	}
 
-	void Mesh::createIndexBuffer(std::vector<uint32_t>& indices)
+	void IndexBuffer::bind(VkCommandBuffer& command_buffer)
 	{
-		VkDeviceSize buffer_size{ sizeof(indices[0]) * indices.size() };
-		Buffer staging(r_device, buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		vkCmdBindIndexBuffer(command_buffer, m_buffer->getBuffer(), 0, m_type);
+	}
 
-		// move memory to device
-		staging.map();
-		staging.writeToBuffer((void*)indices.data());
+	Mesh::Mesh(BufferPool& pool, Data& data)
+		:r_pool(pool), m_vertex_buffer(pool.upload(data.vertices.data(),
+			sizeof(Vertex) * data.vertices.size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT)),
+		m_index_buffer(std::make_shared<IndexBuffer>(pool, data.indices)),
+		m_vertex_count(data.vertices.size())
+	{}
+
+	Mesh::Mesh(BufferPool& pool, std::vector<Vertex>& vertices, std::shared_ptr<IndexBuffer> indices)
+		:r_pool(pool), m_vertex_buffer(pool.upload(vertices.data(), sizeof(Vertex) * vertices.size(),
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT)),
+		m_index_buffer(std::move(indices)), m_vertex_count(vertices.size())
+	{}
 
-		// move staging to vertex buffer
-		m_index_buffer = std::make_unique<Buffer>(r_device, buffer_size,
-			VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		m_index_buffer->copyBuffer(staging.getBuffer(), buffer_size);
+	Mesh::Mesh(BufferPool& pool, const TerrainVertex* vertices, size_t vertex_count,
+		std::shared_ptr<IndexBuffer> indices)
+		:r_pool(pool), m_vertex_buffer(pool.upload(vertices, sizeof(TerrainVertex) * vertex_count,
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT)),
+		m_index_buffer(std::move(indices)), m_vertex_count(vertex_count)
+	{}
+
+	Mesh::~Mesh()
+	{
+		r_pool.release(std::move(m_vertex_buffer));
+	}
+
+	void Mesh::bind(VkCommandBuffer& command_buffer)
+	{
+		VkBuffer buffers[] = { m_vertex_buffer->getBuffer() };
+		VkDeviceSize offsets[] = { 0 };
+		vkCmdBindVertexBuffers(command_buffer, 0, 1, buffers, offsets);
+
+		m_index_buffer->bind(command_buffer);
+	}
+
+	void Mesh::draw(VkCommandBuffer& command_buffer)
+	{
+		vkCmdDrawIndexed(command_buffer, m_index_buffer->count(), 1, 0, 0, 0);
+	}
+
+	void Mesh::draw(VkCommandBuffer& command_buffer, const IndexRange& range)
+	{
+		vkCmdDrawIndexed(command_buffer, range.count, 1, range.first, 0, 0);
 	}
-	
 }
\ No newline at end of file
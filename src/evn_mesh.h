@@ -3,6 +3,7 @@
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 #include <array>
+#include <vector>
 #include <memory>
 #include "evn_device.h"
 #include "evn_buffer.h"
@@ -23,8 +24,8 @@ namespace evn {
 			return desc;
 		}
 
-		static inline std::array<VkVertexInputAttributeDescription, 3> getAttributes() {
-			std::array<VkVertexInputAttributeDescription, 3> attribs{};
+		static inline std::vector<VkVertexInputAttributeDescription> getAttributes() {
+			std::vector<VkVertexInputAttributeDescription> attribs(3);
 			
 			attribs[0].binding = 0;
 			attribs[0].location = 0;
@@ -44,29 +45,129 @@ namespace evn {
 		}
 	};
 
+	// height and normal of one heightfield vertex in 4 bytes, a Heightmap
+	// is a grid of these
+	struct TerrainSample {
+		uint16_t height;  // half float
+		int8_t normal[2]; // octahedral, see encodeNormal
+
+		static TerrainSample pack(float height, const glm::vec3& normal);
+		// unit vector to its two octahedral coordinates in [-1, 1]. the
+		// downward hemisphere, where the terrain normals are, is unfolded
+		static glm::vec2 encodeNormal(const glm::vec3& normal);
+		// float to IEEE half, rounding to nearest even
+		static uint16_t toHalf(float value);
+	};
+	static_assert(sizeof(TerrainSample) == 4, "TerrainSample must stay packed");
+
+	// packed heightfield vertex, 8 bytes instead of 36. x and z are grid
+	// coordinates inside the chunk, the chunk's offset comes in as a push
+	// constant. the colour is worked out from the height in terrain.vert
+	struct TerrainVertex {
+		uint16_t x;
+		uint16_t z;
+		uint16_t height;
+		int8_t normal[2];
+
+		static TerrainVertex pack(int x, int z, const TerrainSample& sample);
+
+		static inline VkVertexInputBindingDescription getBindingDesc() {
+			VkVertexInputBindingDescription desc{};
+			desc.binding = 0;
+			desc.stride = sizeof(TerrainVertex);
+			desc.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+			return desc;
+		}
+
+		static inline std::vector<VkVertexInputAttributeDescription> getAttributes() {
+			std::vector<VkVertexInputAttributeDescription> attribs(3);
+
+			attribs[0].binding = 0;
+			attribs[0].location = 0;
+			attribs[0].format = VK_FORMAT_R16G16_UINT;
+			attribs[0].offset = offsetof(TerrainVertex, x);
+
+			attribs[1].binding = 0;
+			attribs[1].location = 1;
+			attribs[1].format = VK_FORMAT_R16_SFLOAT;
+			attribs[1].offset = offsetof(TerrainVertex, height);
+
+			attribs[2].binding = 0;
+			attribs[2].location = 2;
+			attribs[2].format = VK_FORMAT_R8G8_SNORM;
+			attribs[2].offset = offsetof(TerrainVertex, normal);
+			return attribs;
+		}
+	};
+	static_assert(sizeof(TerrainVertex) == 8, "TerrainVertex must stay packed");
+
+	// pushed before each chunk's draw call. offset is the world position
+	// of its first vertex, a Heightmap also needs its row length and the
+	// spacing of its samples to place them
+	struct ChunkPushConstants {
+		int32_t offset[2];
+		int32_t width;
+		int32_t step;
+	};
+
 	struct Data {
 		std::vector<Vertex> vertices{};
 		std::vector<uint32_t> indices{};
+
+		// reorders the triangles for the post-transform cache, then the
+		// vertices in the order they are fetched. the mesh looks the same
+		void optimize();
+	};
+
+	// a run of indices drawn on its own
+	struct IndexRange {
+		uint32_t first{ 0 };
+		uint32_t count{ 0 };
+	};
+
+	// device local index list that any number of meshes can draw with,
+	// 16 bit indices halve the memory and fetch bandwidth when they fit
+	class IndexBuffer {
+	public:
+		IndexBuffer(BufferPool& pool, std::vector<uint16_t>& indices);
+		IndexBuffer(BufferPool& pool, std::vector<uint32_t>& indices);
+		~IndexBuffer();
+		IndexBuffer(const IndexBuffer&) = delete;
+		IndexBuffer& operator=(const IndexBuffer&) = delete;
+		void bind(VkCommandBuffer& command_buffer);
+		inline uint32_t count() const { return m_count; }
+		inline VkDeviceSize bytes() const { return m_buffer->size(); }
+
+	private:
+		BufferPool& r_pool;
+		std::unique_ptr<Buffer> m_buffer;
+		uint32_t m_count;
+		VkIndexType m_type;
 	};
 
 	class Mesh {
 	public:
-		Mesh(Device& device, Data& data);
+		Mesh(BufferPool& pool, Data& data);
+		// the vertices are uploaded, the indices are shared with other meshes
+		Mesh(BufferPool& pool, std::vector<Vertex>& vertices, std::shared_ptr<IndexBuffer> indices);
+		Mesh(BufferPool& pool, const TerrainVertex* vertices, size_t vertex_count,
+			std::shared_ptr<IndexBuffer> indices);
 		~Mesh();
+		// the vertex buffer goes back to the pool when the mesh is destroyed,
+		// a moved from mesh has none
+		Mesh(Mesh&& other) = default;
+		Mesh(const Mesh&) = delete;
+		Mesh& operator=(const Mesh&) = delete;
 		void bind(VkCommandBuffer& command_buffer);
 		void draw(VkCommandBuffer& command_buffer);
+		void draw(VkCommandBuffer& command_buffer, const IndexRange& range);
+		inline VkDeviceSize vertexBytes() const { return m_vertex_buffer->size(); }
+		inline const IndexBuffer& indices() const { return *m_index_buffer; }
 
 	private:
-		
-		void createVertexBuffer(std::vector<Vertex>& vertices);
-		void createIndexBuffer(std::vector<uint32_t>& indices);
-		
-
-	private:
-		Device& r_device;
+		BufferPool& r_pool;
 		std::unique_ptr<Buffer> m_vertex_buffer;
-		std::unique_ptr<Buffer> m_index_buffer;
-		uint32_t m_index_count;
+		std::shared_ptr<IndexBuffer> m_index_buffer;
 		uint32_t m_vertex_count;
 
 	};
@@ -47,8 +47,8 @@ namespace evn {
             vertex_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
             vertex_input_info.vertexAttributeDescriptionCount = static_cast<uint32_t>(attribs.size());
             vertex_input_info.pVertexAttributeDescriptions = attribs.data();
-            vertex_input_info.vertexBindingDescriptionCount = 1;
-            vertex_input_info.pVertexBindingDescriptions = &binding_desc;
+            vertex_input_info.vertexBindingDescriptionCount = static_cast<uint32_t>(binding_desc.size());
+            vertex_input_info.pVertexBindingDescriptions = binding_desc.data();
 
             VkGraphicsPipelineCreateInfo pipeline_info{};
             pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
@@ -115,7 +115,7 @@ namespace evn {
         void Pipeline::defaultPipelineConfigInfo(PipelineConfigInfo& config)
         {
             // vertex attributes
-            config.binding_descriptions = Vertex::getBindingDesc();
+            config.binding_descriptions = { Vertex::getBindingDesc() };
             config.attribute_descriptions = Vertex::getAttributes();
 
 
@@ -13,8 +13,9 @@ namespace evn {
         PipelineConfigInfo(const PipelineConfigInfo&) = delete;
         PipelineConfigInfo& operator=(const PipelineConfigInfo&) = delete;
 
-        VkVertexInputBindingDescription binding_descriptions{};
-        std::array<VkVertexInputAttributeDescription, 3> attribute_descriptions{};
+        // empty for shaders that fetch their own vertices
+        std::vector<VkVertexInputBindingDescription> binding_descriptions{};
+        std::vector<VkVertexInputAttributeDescription> attribute_descriptions{};
         VkPipelineViewportStateCreateInfo viewport_info;
         VkPipelineInputAssemblyStateCreateInfo input_assembly_info;
         VkPipelineRasterizationStateCreateInfo raster_info;
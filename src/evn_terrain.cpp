@@ -1,118 +1,414 @@
 #include "evn_terrain.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "util/mesh_optimizer.h"
 
 namespace evn {
-    Terrain::Terrain(Device& device, int x_offset, int y_offset)
-        : m_perlin_noise(16), r_device(device), m_xoffset(x_offset),
-          m_yoffset(y_offset)
+    Terrain::Terrain(BufferPool& buffer_pool, std::shared_ptr<const evn_util::NoiseGraph> graph,
+        std::shared_ptr<const GridIndices> grid_indices, HeightmapPool* heightmap_pool,
+        NormalSource normal_source, int lod, int x_offset, int y_offset)
+        : m_graph(std::move(graph)), m_grid_indices(std::move(grid_indices)),
+          r_buffer_pool(buffer_pool), p_heightmap_pool(heightmap_pool), m_normal_source(normal_source),
+          m_lod(lod), m_edge_lods{lod, lod, lod, lod}, m_water(false),
+          m_xoffset(x_offset), m_yoffset(y_offset),
+          m_grid_width(lodWidth(lod)), m_grid_step(lodStep(lod)),
+          m_min_height(std::numeric_limits<float>::max()),
+          m_max_height(std::numeric_limits<float>::lowest())
+    {}
+
+    Terrain::~Terrain()
+    {}
+
+    void Terrain::generate()
     {
+        // the staging vectors keep their capacity from the chunk that had
+        // them last, so sizing them here doesn't allocate
+        m_staging = evn_util::StagingPool<Staging>::shared().acquire();
         initMesh();
+        if (p_heightmap_pool)
+            return;
+
+        // the packed vertices carry their grid position, bake it in here
+        // so the upload is only a copy
+        const std::vector<TerrainSample>& samples {m_staging->samples};
+        std::vector<TerrainVertex>& vertices {m_staging->vertices};
+        vertices.resize(samples.size());
+        for (size_t i{0}; i < samples.size(); i++)
+            vertices[i] = TerrainVertex::pack((int)(i % m_grid_width) * m_grid_step,
+                (int)(i / m_grid_width) * m_grid_step, samples[i]);
     }
 
-    Terrain::Terrain(const Terrain& other)
-        : m_perlin_noise(other.m_perlin_noise), r_device(other.r_device),
-          m_xoffset(other.m_xoffset), m_yoffset(other.m_yoffset)
+    void Terrain::upload()
     {
-        initMesh();
+        const Staging& staging {*m_staging};
+        if (p_heightmap_pool)
+            m_heightmap = std::make_unique<Heightmap>(r_buffer_pool, *p_heightmap_pool,
+                staging.samples.data(), staging.samples.size(), m_grid_indices->buffer);
+        else
+            m_mesh = std::make_unique<Mesh>(r_buffer_pool, staging.vertices.data(), staging.vertices.size(),
+                m_grid_indices->buffer);
+        m_staging.reset();
     }
 
-    Terrain::~Terrain()
-    {}
+    VkDeviceSize Terrain::deviceBytes() const
+    {
+        if (m_heightmap)
+            return m_heightmap->sampleBytes();
+        return m_mesh ? m_mesh->vertexBytes() : 0;
+    }
 
-    void Terrain::update(VkCommandBuffer & command_buffer)
+    evn_util::Aabb Terrain::bounds() const
     {
-        m_mesh->bind(command_buffer);
-        m_mesh->draw(command_buffer);
+        // the heights are stored as half floats, pad for their rounding
+        const float padding {0.1f};
+        float size {(float)(MESH_WIDTH - 1)};
+        return {{(float)m_xoffset, m_min_height - padding, (float)m_yoffset},
+            {m_xoffset + size, m_max_height + padding, m_yoffset + size}};
     }
 
-    void Terrain::initMesh()
+    void Terrain::update(VkCommandBuffer & command_buffer, VkPipelineLayout& pipeline_layout)
     {
-        Data mesh_data{};
+        ChunkPushConstants push {{m_xoffset, m_yoffset}, m_grid_width, m_grid_step};
+        vkCmdPushConstants(command_buffer, pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0,
+            sizeof(push), &push);
+        if (m_heightmap)
+            m_heightmap->bind(command_buffer, pipeline_layout);
+        else
+            m_mesh->bind(command_buffer);
+        if (m_water) {
+            draw(command_buffer, m_grid_indices->water);
+            return;
+        }
 
-        // create the vertices and indices
-        // the mesh will be a 256 x 256 size object
-        mesh_data.vertices.resize((size_t)MESH_HEIGHT * MESH_WIDTH);
-        mesh_data.indices.resize((size_t)((MESH_WIDTH - 1) * (MESH_HEIGHT - 1) * 6));
-        
-        int vertex_index {0};
-        int triangle_index {0};
-
-        for (int y{0}; y < MESH_HEIGHT; y++) {
-            for (int x{0}; x < MESH_WIDTH; x++) {
-                float new_x{ (float)(x + m_xoffset) };
-                float new_y{ (float)(y + m_yoffset) };
-                float height {(m_perlin_noise.octavePerlin(ABS(new_x),ABS(new_y), 6) )};
-                auto color {getColorFromHeight(height)};
-                mesh_data.vertices[vertex_index] = { 
-                                {new_x, height, new_y}, // position
-                                color,                            // color
-                                {0, 0, 0}                         // temp normal
-                                };
-
-                // give the indices for the triangle
-                if (x < MESH_WIDTH - 1 && y < MESH_HEIGHT - 1) {
-                    // add two triangles for the square
-                    mesh_data.indices[triangle_index] = vertex_index;
-                    mesh_data.indices[triangle_index + 1] = vertex_index + MESH_WIDTH + 1;
-                    mesh_data.indices[triangle_index + 2] = vertex_index + MESH_WIDTH;
-                    triangle_index += 3;
-
-                    mesh_data.indices[triangle_index] = vertex_index + MESH_WIDTH + 1;
-                    mesh_data.indices[triangle_index + 1] = vertex_index;
-                    mesh_data.indices[triangle_index + 2] = vertex_index + 1;
-                    triangle_index += 3;
-                }
+        draw(command_buffer, m_grid_indices->interior);
+        for (int edge{0}; edge < EDGE_COUNT; edge++)
+            draw(command_buffer, m_grid_indices->edges[edge][m_edge_lods[edge] - m_lod]);
+    }
 
-                vertex_index++;
+    void Terrain::setEdgeLods(const EdgeLods& neighbour_lods)
+    {
+        // a finer neighbour is the one that matches this chunk
+        for (int edge{0}; edge < EDGE_COUNT; edge++)
+            m_edge_lods[edge] = std::clamp(neighbour_lods[edge], m_lod, LOD_LEVELS - 1);
+    }
+
+    std::shared_ptr<evn_util::NoiseEngine> Terrain::createNoise(evn_util::NoiseType type)
+    {
+        if (type == evn_util::NoiseType::Simplex)
+            return std::make_shared<evn_util::SimplexNoise>(NOISE_CELL_SIZE, WORLD_SEED);
+        auto perlin {std::make_shared<evn_util::PerlinNoise>(NOISE_CELL_SIZE,
+            evn_util::GradientMode::Table, WORLD_SEED)};
+        perlin->setCoarseTolerance(NOISE_TOLERANCE);
+        return perlin;
+    }
+
+    std::shared_ptr<evn_util::NoiseGraph> Terrain::createGraph(evn_util::NoiseType type, int octaves)
+    {
+        auto graph {std::make_shared<evn_util::NoiseGraph>(createNoise(type))};
+        graph->setOutput(graph->fbm(graph->coordX(), graph->coordY(), octaves));
+        graph->compile();
+        return graph;
+    }
+
+    int Terrain::lodOctaves(evn_util::NoiseType type, int lod)
+    {
+        // octaves whose lattice is no coarser than the vertex spacing only
+        // add detail between vertices. perlin noise is zero on its lattice,
+        // so with it they add nothing at all and the heights stay the same
+        // as the finer levels' at the vertices both have. simplex isn't
+        // zero there, dropping them would move the shared edge vertices
+        // apart and open cracks the edge strips can't close
+        if (lod == 0 || type != evn_util::NoiseType::Perlin)
+            return NOISE_OCTAVES;
+        int octaves {0};
+        while (octaves < NOISE_OCTAVES && (NOISE_CELL_SIZE >> octaves) > lodStep(lod))
+            octaves++;
+        return std::max(octaves, 1);
+    }
+
+    std::shared_ptr<const Terrain::GridIndices> Terrain::createGridIndices(BufferPool& buffer_pool, int lod)
+    {
+        static_assert(MESH_WIDTH * MESH_HEIGHT <= 65536, "grid indices must fit in 16 bits");
+        static_assert(MESH_WIDTH == MESH_HEIGHT, "levels of detail assume a square chunk");
+        static_assert((MESH_WIDTH - 1) % (1 << (LOD_LEVELS - 1)) == 0,
+            "every level of detail must end on the chunk's edge");
+        const int width {lodWidth(lod)};
+        auto grid {std::make_shared<GridIndices>()};
+        // the interior, every cell that doesn't touch the edge
+        std::vector<uint16_t> indices((size_t)(width - 3) * (width - 3) * 6);
+        size_t triangle_index {0};
+        for (int y{1}; y < width - 2; y++) {
+            for (int x{1}; x < width - 2; x++) {
+                uint16_t vertex_index {(uint16_t)(y * width + x)};
+                // add two triangles for the square
+                indices[triangle_index] = vertex_index;
+                indices[triangle_index + 1] = vertex_index + width + 1;
+                indices[triangle_index + 2] = vertex_index + width;
+                triangle_index += 3;
+
+                indices[triangle_index] = vertex_index + width + 1;
+                indices[triangle_index + 1] = vertex_index;
+                indices[triangle_index + 2] = vertex_index + 1;
+                triangle_index += 3;
             }
         }
+        // row by row the previous row is out of the vertex cache by the time
+        // it is used again, about one vertex shader run per triangle.
+        // reordered it is closer to 0.6
+        evn_util::optimizeVertexCache(indices.data(), indices.size(), (size_t)width * width);
+        grid->interior = {0, (uint32_t)indices.size()};
 
-        calculateNormals(mesh_data);
+        // then the ring of cells around it, one strip per edge and level
+        for (int edge{0}; edge < EDGE_COUNT; edge++) {
+            for (int coarser{0}; lod + coarser < LOD_LEVELS; coarser++) {
+                uint32_t first {(uint32_t)indices.size()};
+                zipEdge(width, (Edge)edge, 1 << coarser, indices);
+                grid->edges[edge][coarser] = {first, (uint32_t)indices.size() - first};
+            }
+        }
 
-        m_mesh = std::make_unique<Mesh>(r_device, mesh_data);
+        // and the corners of the full mesh for all water chunks, wound the
+        // same way as the grid
+        grid->water = {(uint32_t)indices.size(), 6};
+        indices.insert(indices.end(), {0, 3, 2, 3, 0, 1});
+        grid->buffer = std::make_shared<IndexBuffer>(buffer_pool, indices);
+        return grid;
     }
 
-    void  Terrain::calculateNormals(Data& mesh_data)
+    void Terrain::zipEdge(int width, Edge edge, int stride, std::vector<uint16_t>& indices)
     {
-        int triangle_count {(int)(mesh_data.indices.size() / 3)};
+        // vertex t along the edge in its outer row, or the row inside it
+        auto vertex = [&](int t, bool inner) {
+            int depth {inner ? 1 : 0};
+            switch (edge) {
+            case EDGE_LEFT:  return (uint16_t)(t * width + depth);
+            case EDGE_RIGHT: return (uint16_t)(t * width + width - 1 - depth);
+            case EDGE_TOP:   return (uint16_t)(depth * width + t);
+            default:         return (uint16_t)((width - 1 - depth) * width + t);
+            }
+        };
+        // the rows run the other way around the chunk on these two
+        const bool flip {edge == EDGE_LEFT || edge == EDGE_BOTTOM};
+        auto triangle = [&](uint16_t a, uint16_t b, uint16_t c) {
+            indices.insert(indices.end(), {a, flip ? c : b, flip ? b : c});
+        };
 
-        for (int i {0}; i < triangle_count; i++)
-        {
-            int normal_triangle_index {i * 3};
-            uint32_t vertex_a {mesh_data.indices[normal_triangle_index]};
-            uint32_t vertex_b {mesh_data.indices[normal_triangle_index + 1]};
-            uint32_t vertex_c {mesh_data.indices[normal_triangle_index + 2]};
+        // the outer row runs 0 to width - 1 in strides, the inner one 1 to
+        // width - 2. step along whichever row's next segment is centred
+        // first so the triangles stay close to even
+        const int last {width - 1};
+        int outer {0};
+        int inner {1};
+        while (outer < last || inner < last - 1) {
+            bool step_outer {inner == last - 1 || (outer < last && 2 * outer + stride <= 2 * inner + 1)};
+            if (step_outer) {
+                triangle(vertex(outer, false), vertex(outer + stride, false), vertex(inner, true));
+                outer += stride;
+            } else {
+                triangle(vertex(outer, false), vertex(inner + 1, true), vertex(inner, true));
+                inner++;
+            }
+        }
+    }
+
+    void Terrain::initMesh()
+    {
+        // the chunk is a regular grid, evaluate all of its heights at once.
+        // central differences need one more sample past each edge, the same
+        // heights the neighbouring chunk has there
+        const int apron {m_normal_source == NormalSource::CentralDifference ? 1 : 0};
+        const int width {lodWidth(m_lod)};
+        const int step {lodStep(m_lod)};
+        const int grid_width {width + 2 * apron};
+        const int grid_height {width + 2 * apron};
+        const bool analytic {m_normal_source == NormalSource::Analytic};
+        // every array here is dropped once the samples are packed, they come
+        // from the thread's arena so streaming chunks doesn't hit the heap
+        evn_util::ScratchArena& arena {evn_util::ScratchArena::local()};
+        evn_util::ScratchArena::Scope scope {arena};
+        auto sample_x {arena.allocate<float>(grid_width)};
+        auto sample_y {arena.allocate<float>(grid_height)};
+        auto heights {arena.allocate<float>((size_t)grid_width * grid_height)};
+        auto slopes_x {arena.allocate<float>(analytic ? heights.size() : 0)};
+        auto slopes_y {arena.allocate<float>(analytic ? heights.size() : 0)};
+        for (int x{0}; x < grid_width; x++) {
+            float new_x{ (float)((x - apron) * step + m_xoffset) };
+            sample_x[x] = ABS(new_x);
+        }
+        for (int y{0}; y < grid_height; y++) {
+            float new_y{ (float)((y - apron) * step + m_yoffset) };
+            sample_y[y] = ABS(new_y);
+        }
+
+        // a coarse bound over the whole chunk catches open ocean before
+        // any noise is summed
+        auto [min_x, max_x] {std::minmax_element(sample_x.begin() + apron, sample_x.end() - apron)};
+        auto [min_y, max_y] {std::minmax_element(sample_y.begin() + apron, sample_y.end() - apron)};
+        if (m_graph->below(*min_x, *max_x, *min_y, *max_y, WATER_LEVEL)) {
+            initWaterMesh();
+            return;
+        }
+
+        // water is flattened anyway, so samples stop summing octaves as soon
+        // as they can't make it back above the water level
+        if (apron)
+            evaluateApronGrid(sample_x, sample_y, heights);
+        else
+            m_graph->evaluateGrid(sample_x.data(), grid_width, sample_y.data(), grid_height,
+                heights.data(), slopes_x.data(), slopes_y.data(), WATER_LEVEL);
+        if (std::all_of(heights.begin(), heights.end(), [](float h) { return h < WATER_LEVEL; })) {
+            initWaterMesh();
+            return;
+        }
+
+        // pack the vertices, the indices are shared by every chunk
+        std::vector<TerrainSample>& samples {m_staging->samples};
+        samples.resize((size_t)width * width);
+        if (analytic)
+            analyticSamples(heights, slopes_x, slopes_y, samples.data());
+        else
+            differenceSamples(heights, samples.data());
+    }
+
+    void Terrain::evaluateApronGrid(const evn_util::ScratchArray<float>& sample_x,
+        const evn_util::ScratchArray<float>& sample_y, const evn_util::ScratchArray<float>& heights)
+    {
+        // an apron sample across an axis is the mirror of the one two
+        // samples in, the noise is sampled at ABS(x). it is copied instead
+        // so the rest stay evenly spaced for the perlin grid's coarse octaves
+        const int grid_width {(int)sample_x.size()};
+        const int grid_height {(int)sample_y.size()};
+        int x0 {m_xoffset == 0 ? 1 : 0};
+        int x1 {m_xoffset + MESH_WIDTH - 1 == 0 ? grid_width - 1 : grid_width};
+        int y0 {m_yoffset == 0 ? 1 : 0};
+        int y1 {m_yoffset + MESH_HEIGHT - 1 == 0 ? grid_height - 1 : grid_height};
+        if (x0 == 0 && x1 == grid_width && y0 == 0 && y1 == grid_height) {
+            m_graph->evaluateGrid(sample_x.data(), grid_width, sample_y.data(), grid_height,
+                heights.data(), nullptr, nullptr, WATER_LEVEL);
+            return;
+        }
+
+        evn_util::ScratchArena& arena {evn_util::ScratchArena::local()};
+        evn_util::ScratchArena::Scope scope {arena};
+        auto inner {arena.allocate<float>((size_t)(x1 - x0) * (y1 - y0))};
+        m_graph->evaluateGrid(sample_x.data() + x0, x1 - x0, sample_y.data() + y0, y1 - y0,
+            inner.data(), nullptr, nullptr, WATER_LEVEL);
+        for (int y{y0}; y < y1; y++) {
+            float* row {&heights[(size_t)y * grid_width]};
+            std::copy_n(&inner[(size_t)(y - y0) * (x1 - x0)], x1 - x0, row + x0);
+            if (x0 == 1)
+                row[0] = row[2];
+            if (x1 == grid_width - 1)
+                row[grid_width - 1] = row[grid_width - 3];
+        }
+        if (y0 == 1)
+            std::copy_n(&heights[(size_t)2 * grid_width], grid_width, heights.data());
+        if (y1 == grid_height - 1)
+            std::copy_n(&heights[(size_t)(grid_height - 3) * grid_width], grid_width,
+                &heights[(size_t)(grid_height - 1) * grid_width]);
+    }
 
-            glm::vec3 triangle_normal {surfaceNormalFromIndices(vertex_a, vertex_b, vertex_c, mesh_data)};
-            mesh_data.vertices[vertex_a].normal += triangle_normal;
-            mesh_data.vertices[vertex_b].normal += triangle_normal;
-            mesh_data.vertices[vertex_c].normal += triangle_normal;
+    void Terrain::analyticSamples(const evn_util::ScratchArray<float>& heights,
+        const evn_util::ScratchArray<float>& slopes_x, const evn_util::ScratchArray<float>& slopes_y,
+        TerrainSample* samples)
+    {
+        const int width {lodWidth(m_lod)};
+        const int step {lodStep(m_lod)};
+        int vertex_index {0};
+        for (int y{0}; y < width; y++) {
+            for (int x{0}; x < width; x++) {
+                float new_x{ (float)(x * step + m_xoffset) };
+                float new_y{ (float)(y * step + m_yoffset) };
+                float height {heights[vertex_index]};
+                float world_height {worldHeight(height)};
+                m_min_height = std::min(m_min_height, world_height);
+                m_max_height = std::max(m_max_height, world_height);
+                // water and the shore below zero are flattened
+                bool flat {height < 0};
+                // the noise is sampled at ABS(x), so the slope flips with the sign
+                float slope_x {new_x < 0 ? -slopes_x[vertex_index] : slopes_x[vertex_index]};
+                float slope_y {new_y < 0 ? -slopes_y[vertex_index] : slopes_y[vertex_index]};
+                samples[vertex_index] = TerrainSample::pack(world_height,
+                    normalFromSlope(flat ? 0 : slope_x, flat ? 0 : slope_y));
+
+                vertex_index++;
+            }
         }
+    }
+
+    void Terrain::differenceSamples(const evn_util::ScratchArray<float>& heights, TerrainSample* samples)
+    {
+        // differences are taken on the surface as it is drawn, so samples
+        // the cutoff stopped early are simply water
+        const int width {lodWidth(m_lod)};
+        const int grid_width {width + 2};
+        const float spacing {0.5f / lodStep(m_lod)};
+        for (auto& height : heights)
+            height = worldHeight(height);
 
-        for (int i {0}; i < mesh_data.vertices.size(); i++)
-            mesh_data.vertices[i].normal = glm::normalize(mesh_data.vertices[i].normal);
+        // one row at a time in separate arrays so the loops vectorise
+        std::array<float, MESH_WIDTH> normal_x;
+        std::array<float, MESH_WIDTH> normal_y;
+        std::array<float, MESH_WIDTH> normal_z;
+        for (int y{0}; y < width; y++) {
+            const float* above {&heights[(size_t)y * grid_width]};
+            const float* row {above + grid_width};
+            const float* below {row + grid_width};
+            for (int x{0}; x < width; x++) {
+                // the normal points into the ground like normalFromSlope's
+                float slope_x {spacing * (row[x + 2] - row[x])};
+                float slope_y {spacing * (below[x + 1] - above[x + 1])};
+                // water and the shore are flat
+                float land {row[x + 1] > 0 ? 1.0f : 0.0f};
+                slope_x *= land;
+                slope_y *= land;
+                float length {1.0f / std::sqrt(slope_x * slope_x + slope_y * slope_y + 1.0f)};
+                normal_x[x] = slope_x * length;
+                normal_y[x] = -length;
+                normal_z[x] = slope_y * length;
+            }
+            TerrainSample* out {&samples[(size_t)y * width]};
+            for (int x{0}; x < width; x++)
+                out[x] = TerrainSample::pack(row[x + 1], {normal_x[x], normal_y[x], normal_z[x]});
+            auto [low, high] {std::minmax_element(row + 1, row + 1 + width)};
+            m_min_height = std::min(m_min_height, *low);
+            m_max_height = std::max(m_max_height, *high);
+        }
+    }
+
+    void Terrain::initWaterMesh()
+    {
+        TerrainSample water {TerrainSample::pack(worldHeight(WATER_LEVEL), normalFromSlope(0, 0))};
+
+        // the corners of the full mesh, drawn with the grid's water range
+        m_staging->samples.assign(4, water);
+        m_min_height = m_max_height = worldHeight(WATER_LEVEL);
+        m_water = true;
+        m_grid_width = 2;
+        m_grid_step = MESH_WIDTH - 1;
     }
 
-    glm::vec3 Terrain::surfaceNormalFromIndices(uint32_t a, uint32_t b, uint32_t c, Data& mesh_data)
+    void Terrain::draw(VkCommandBuffer& command_buffer, const IndexRange& range)
     {
-        auto point_a {mesh_data.vertices[a].pos};
-        auto point_b {mesh_data.vertices[b].pos};
-        auto point_c {mesh_data.vertices[c].pos};
+        if (m_heightmap)
+            m_heightmap->draw(command_buffer, range);
+        else
+            m_mesh->draw(command_buffer, range);
+    }
 
-        glm::vec3 side_ab {point_a - point_b};
-        glm::vec3 side_ac {point_a - point_c};
-        auto normal = glm::normalize(glm::cross(side_ab, side_ac));
-        return normal;
+    glm::vec3 Terrain::normalFromSlope(float slope_x, float slope_y)
+    {
+        // the surface is HEIGHT_SCALE * noise, its normal points into the
+        // ground like the shader expects
+        return glm::normalize(glm::vec3{HEIGHT_SCALE * slope_x, -1.0f, HEIGHT_SCALE * slope_y});
     }
 
-    glm::vec3 Terrain::getColorFromHeight(float& height)
+    float Terrain::worldHeight(float height)
     {
         int color = (int)(((height + 1.0f) * 0.5f) * 255);
-        if (color < 90) {
-            height = -0.1;
-            return { 0., 0.0, 1. };
-        } 
-        height =  (height * 20 < 0) ? 0 : height * 20;
-        if (color < 150) return { 0., 1.0, 0.0 };
-        return { 0.5, 0.5, 0.5 };
+        if (color < 90)
+            return WATER_HEIGHT;
+        return (height * HEIGHT_SCALE < 0) ? 0 : height * HEIGHT_SCALE;
     }
 }
\ No newline at end of file
@@ -1,34 +1,146 @@
 #pragma once
 
+#include <array>
 #include <memory>
 #include "util/perlin_noise.h"
-#include "evn_mesh.h"
+#include "util/simplex_noise.h"
+#include "util/noise_graph.h"
+#include "util/scratch_arena.h"
+#include "util/staging_pool.h"
+#include "evn_chunk.h"
+#include "evn_heightmap.h"
 
 // perlin method breaks with negative numbers
 #define ABS(x) (x >= 0 ? x : x * -1)
 
 namespace evn {
-    class Terrain {
+    class Terrain : public Chunk {
     public:
-        Terrain(Device& device, int x_offset, int y_offset);
-        Terrain(const Terrain& other);
+        struct GridIndices;
+        // chunk edges, x = 0, x = end, y = 0 and y = end
+        enum Edge { EDGE_LEFT, EDGE_RIGHT, EDGE_TOP, EDGE_BOTTOM, EDGE_COUNT };
+        // level of detail of the chunk across each edge
+        using EdgeLods = std::array<int, EDGE_COUNT>;
+
+        // without a heightmap pool the chunk uploads a TerrainVertex buffer.
+        // graph and grid_indices have to be the ones made for lod. nothing is
+        // evaluated until generate
+        Terrain(BufferPool& buffer_pool, std::shared_ptr<const evn_util::NoiseGraph> graph,
+            std::shared_ptr<const GridIndices> grid_indices, HeightmapPool* heightmap_pool,
+            NormalSource normal_source, int lod, int x_offset, int y_offset);
+        // chunks move without being generated again, copies aren't allowed
+        Terrain(Terrain&& other) = default;
+        Terrain(const Terrain&) = delete;
+        Terrain& operator=(const Terrain&) = delete;
         ~Terrain();
-        void update(VkCommandBuffer& command_buffer);
+        void generate() override;
+        void upload() override;
+        // the shared grid indices aren't counted
+        VkDeviceSize deviceBytes() const override;
+        evn_util::Aabb bounds() const override;
+        void update(VkCommandBuffer& command_buffer, VkPipelineLayout& pipeline_layout) override;
+        inline int lod() const { return m_lod; }
+        // match the edges to coarser neighbours so no cracks open between
+        // them. only picks which strips to draw, the samples stay as they are
+        void setEdgeLods(const EdgeLods& neighbour_lods);
+        static std::shared_ptr<evn_util::NoiseEngine> createNoise(evn_util::NoiseType type);
+        // the default heightfield, plain fbm of the world coordinates
+        static std::shared_ptr<evn_util::NoiseGraph> createGraph(evn_util::NoiseType type,
+            int octaves = NOISE_OCTAVES);
+        // triangles of the grid at a level of detail, the same for every
+        // chunk so they are uploaded once and shared
+        static std::shared_ptr<const GridIndices> createGridIndices(BufferPool& buffer_pool, int lod);
+        // level of detail lod samples every lodStep(lod)th vertex of the
+        // full grid, lodWidth(lod) of them along each side
+        static int lodStep(int lod) { return 1 << lod; }
+        static int lodWidth(int lod) { return (MESH_WIDTH - 1) / lodStep(lod) + 1; }
+        // octaves worth summing at a level of detail with the given noise
+        static int lodOctaves(evn_util::NoiseType type, int lod);
     public:
         const static int MESH_WIDTH = 241;
         const static int MESH_HEIGHT = 241;
+        // steps of 1, 2, 4 and 8, each level's vertices are also the next
+        // coarser level's. the chunk is square at every level
+        const static int LOD_LEVELS = 4;
+        // every triangle a chunk at one level of detail can be drawn with,
+        // in one buffer. the interior cells, then a strip along each edge
+        // for every level the chunk across it may have. a strip only uses
+        // the outer vertices the coarser chunk has too, so they meet
+        struct GridIndices {
+            std::shared_ptr<IndexBuffer> buffer;
+            IndexRange interior;
+            // [edge][neighbour's lod - lod]
+            std::array<std::array<IndexRange, LOD_LEVELS>, EDGE_COUNT> edges;
+            // the two triangles of an all water chunk's four samples
+            IndexRange water;
+        };
+        // seed for the gradient permutation table
+        const static uint32_t WORLD_SEED = 0;
+        // noise settings, PerlinNoise has a kernel specialised for them
+        const static int NOISE_OCTAVES = 6;
+        const static uint16_t NOISE_CELL_SIZE = 16;
+        // error the perlin grid's slopes may trade for summing its smooth
+        // low octaves on a sub-grid, well under a vertex step once scaled
+        constexpr static float NOISE_TOLERANCE = 0.002f;
+        // noise to world height on land
+        constexpr static float HEIGHT_SCALE = 20.0f;
+        // noise below this is always water, a hair under the colour
+        // threshold in worldHeight so rounding can't disagree
+        constexpr static float WATER_LEVEL = -0.2942f;
+        // world height of the flattened water, and where grass gives way to
+        // rock. terrain.vert colours the vertices with the same values
+        constexpr static float WATER_HEIGHT = -0.1f;
+        constexpr static float ROCK_HEIGHT = 3.5294f;
     private:
+        struct Staging {
+            std::vector<TerrainSample> samples;
+            std::vector<TerrainVertex> vertices;
+        };
         void initMesh();
-        void calculateNormals(Data& mesh_data);
-        glm::vec3 surfaceNormalFromIndices(uint32_t a, uint32_t b, uint32_t c, Data& mesh_data);
-        glm::vec3 getColorFromHeight(float& height);
+        // a single flat quad at sea level for chunks that are all water
+        void initWaterMesh();
+        // heights over the chunk and its one sample apron
+        void evaluateApronGrid(const evn_util::ScratchArray<float>& sample_x,
+            const evn_util::ScratchArray<float>& sample_y, const evn_util::ScratchArray<float>& heights);
+        // samples of the chunk from its heights and their analytic slopes
+        void analyticSamples(const evn_util::ScratchArray<float>& heights,
+            const evn_util::ScratchArray<float>& slopes_x, const evn_util::ScratchArray<float>& slopes_y,
+            TerrainSample* samples);
+        // samples of the chunk from central differences of its heights,
+        // which have a one sample apron. the heights are scaled in place
+        void differenceSamples(const evn_util::ScratchArray<float>& heights, TerrainSample* samples);
+        void draw(VkCommandBuffer& command_buffer, const IndexRange& range);
+        // triangles between an edge's outer row, of which only every
+        // stride-th vertex is used, and the row inside it
+        static void zipEdge(int width, Edge edge, int stride, std::vector<uint16_t>& indices);
+        // vertex normal from the analytic slope of the noise along x and y
+        glm::vec3 normalFromSlope(float slope_x, float slope_y);
+        // noise to the height of the mesh, water and the shore are flat
+        float worldHeight(float height);
     private:
-        evn_util::PerlinNoise m_perlin_noise;
+        // shared by every chunk of the world
+        std::shared_ptr<const evn_util::NoiseGraph> m_graph;
+        std::shared_ptr<const GridIndices> m_grid_indices;
 
         // mesh variables
-        Device &r_device;
+        BufferPool& r_buffer_pool;
+        HeightmapPool* p_heightmap_pool;
+        NormalSource m_normal_source;
+        int m_lod;
+        EdgeLods m_edge_lods;
+        // all water, drawn as one quad with the grid's water range
+        bool m_water;
+        // what generate built for upload, samples for a heightmap and
+        // vertices otherwise. back in the pool once the gpu has them
+        evn_util::StagingPool<Staging>::Handle m_staging;
         std::unique_ptr<Mesh> m_mesh;
+        std::unique_ptr<Heightmap> m_heightmap;
         int m_xoffset;
         int m_yoffset;
+        int m_grid_width;
+        int m_grid_step;
+        // lowest and highest world height of the samples
+        float m_min_height;
+        float m_max_height;
     };
 }
\ No newline at end of file
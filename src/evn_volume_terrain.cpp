@@ -0,0 +1,113 @@
+#include "evn_volume_terrain.h"
+#include "evn_terrain.h"
+#include "util/scratch_arena.h"
+#include <algorithm>
+
+namespace evn {
+    VolumeTerrain::VolumeTerrain(BufferPool& buffer_pool, std::shared_ptr<evn_util::PerlinNoise> noise,
+        int x_offset, int z_offset)
+        : m_noise(std::move(noise)), r_buffer_pool(buffer_pool), m_xoffset(x_offset),
+          m_zoffset(z_offset), m_min_y(FLOOR), m_max_y(FLOOR)
+    {}
+
+    VolumeTerrain::~VolumeTerrain()
+    {}
+
+    VkDeviceSize VolumeTerrain::deviceBytes() const
+    {
+        // every volume chunk has its own indices
+        return m_mesh ? m_mesh->vertexBytes() + m_mesh->indices().bytes() : 0;
+    }
+
+    evn_util::Aabb VolumeTerrain::bounds() const
+    {
+        float size {(float)(CELLS * CELL_SIZE)};
+        return {{(float)m_xoffset, m_min_y, (float)m_zoffset},
+            {m_xoffset + size, m_max_y, m_zoffset + size}};
+    }
+
+    void VolumeTerrain::update(VkCommandBuffer& command_buffer, VkPipelineLayout&)
+    {
+        if (!m_mesh) return;
+        m_mesh->bind(command_buffer);
+        m_mesh->draw(command_buffer);
+    }
+
+    std::shared_ptr<evn_util::PerlinNoise> VolumeTerrain::createNoise()
+    {
+        return std::make_shared<evn_util::PerlinNoise>(NOISE_CELL_SIZE,
+            evn_util::GradientMode::Table, Terrain::WORLD_SEED);
+    }
+
+    void VolumeTerrain::generate()
+    {
+        // density at every corner of the cell grid, x fastest then height
+        // then z. each z plane is one noise batch
+        evn_util::ScratchArena& arena {evn_util::ScratchArena::local()};
+        evn_util::ScratchArena::Scope scope {arena};
+        auto density {arena.allocate<float>((size_t)(CELLS + 1) * (LAYERS + 1) * (CELLS + 1))};
+        evn_util::DensityField field{ density.data(), CELLS, LAYERS, CELLS };
+        evn_util::parallelFor(0, field.pointsZ(), 1, [&](int first, int last) {
+            size_t plane_size {(size_t)field.pointsX() * field.pointsY()};
+            evn_util::ScratchArena& plane_arena {evn_util::ScratchArena::local()};
+            evn_util::ScratchArena::Scope plane_scope {plane_arena};
+            auto xs {plane_arena.allocate<float>(plane_size)};
+            auto ys {plane_arena.allocate<float>(plane_size)};
+            auto zs {plane_arena.allocate<float>(plane_size)};
+            for (int z {first}; z < last; z++) {
+                size_t i {0};
+                for (int y {0}; y < field.pointsY(); y++) {
+                    for (int x {0}; x < field.pointsX(); x++) {
+                        xs[i] = (float)(m_xoffset + x * CELL_SIZE);
+                        ys[i] = (float)(FLOOR + y * CELL_SIZE);
+                        zs[i] = (float)(m_zoffset + z * CELL_SIZE);
+                        i++;
+                    }
+                }
+                float* plane {density.data() + field.index(0, 0, z)};
+                m_noise->octavePerlin3Batch(xs.data(), ys.data(), zs.data(), plane, plane_size,
+                    NOISE_OCTAVES);
+                for (i = 0; i < plane_size; i++)
+                    plane[i] += (GROUND_LEVEL - ys[i]) / RELIEF;
+            }
+        });
+
+        evn_util::IsoMesh surface;
+        evn_util::marchingCubes(field, 0.0f, surface, 1);
+        if (surface.indices.empty())
+            return;
+
+        // the pooled vectors keep the capacity of the chunk that had them last
+        m_data = evn_util::StagingPool<Data>::shared().acquire();
+        Data& mesh_data {*m_data};
+        mesh_data.vertices.resize(surface.positions.size());
+        for (size_t i {0}; i < surface.positions.size(); i++) {
+            const glm::vec3& p {surface.positions[i]};
+            glm::vec3 pos {m_xoffset + p.x * CELL_SIZE, FLOOR + p.y * CELL_SIZE, m_zoffset + p.z * CELL_SIZE};
+            m_min_y = std::min(m_min_y, pos.y);
+            m_max_y = std::max(m_max_y, pos.y);
+            mesh_data.vertices[i] = {
+                            pos,                                  // position
+                            getColor(pos, surface.normals[i]),    // color
+                            surface.normals[i]                    // normal
+                            };
+        }
+        mesh_data.indices.assign(surface.indices.begin(), surface.indices.end());
+        mesh_data.optimize();
+    }
+
+    void VolumeTerrain::upload()
+    {
+        if (m_data)
+            m_mesh = std::make_unique<Mesh>(r_buffer_pool, *m_data);
+        m_data.reset();
+    }
+
+    glm::vec3 VolumeTerrain::getColor(const glm::vec3& pos, const glm::vec3& normal)
+    {
+        // normals point into the ground, flat tops face -y
+        if (pos.y < 0) return { 0.76, 0.7, 0.5 };
+        if (normal.y < -0.7f) return { 0., 1.0, 0.0 };
+        return { 0.5, 0.5, 0.5 };
+    }
+}
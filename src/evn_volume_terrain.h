@@ -0,0 +1,60 @@
+#pragma once
+
+#include <memory>
+#include "util/perlin_noise.h"
+#include "util/marching_cubes.h"
+#include "util/staging_pool.h"
+#include "evn_chunk.h"
+
+namespace evn {
+    // chunk meshed from a 3d density field, so it can hold caves, arches and
+    // overhangs a heightfield can't. density is the 3d noise plus a falloff
+    // with height, solid where it is positive
+    class VolumeTerrain : public Chunk {
+    public:
+        // nothing is evaluated until generate
+        VolumeTerrain(BufferPool& buffer_pool, std::shared_ptr<evn_util::PerlinNoise> noise,
+            int x_offset, int z_offset);
+        ~VolumeTerrain();
+        VolumeTerrain(VolumeTerrain&& other) = default;
+        VolumeTerrain(const VolumeTerrain&) = delete;
+        VolumeTerrain& operator=(const VolumeTerrain&) = delete;
+        // single threaded, chunks are generated side by side instead
+        void generate() override;
+        void upload() override;
+        VkDeviceSize deviceBytes() const override;
+        evn_util::Aabb bounds() const override;
+        void update(VkCommandBuffer& command_buffer, VkPipelineLayout& pipeline_layout) override;
+        static std::shared_ptr<evn_util::PerlinNoise> createNoise();
+    public:
+        // same footprint as Terrain so both stream on the same chunk grid
+        const static int CELLS = 80;
+        const static int CELL_SIZE = 3;
+        const static int LAYERS = 32;
+        // height of the lowest sample layer
+        const static int FLOOR = -32;
+        const static int NOISE_OCTAVES = 4;
+        const static uint16_t NOISE_CELL_SIZE = 48;
+        // height the density crosses zero without noise and how fast it
+        // falls off around it
+        constexpr static float GROUND_LEVEL = 8.0f;
+        constexpr static float RELIEF = 24.0f;
+    private:
+        glm::vec3 getColor(const glm::vec3& pos, const glm::vec3& normal);
+    private:
+        // shared by every chunk of the world
+        std::shared_ptr<evn_util::PerlinNoise> m_noise;
+
+        // mesh variables
+        BufferPool& r_buffer_pool;
+        // what generate built for upload, back in the pool once the gpu has it
+        evn_util::StagingPool<Data>::Handle m_data;
+        // null when the chunk has no surface
+        std::unique_ptr<Mesh> m_mesh;
+        int m_xoffset;
+        int m_zoffset;
+        // lowest and highest vertex of the surface
+        float m_min_y;
+        float m_max_y;
+    };
+}
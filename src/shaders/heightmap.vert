@@ -0,0 +1,37 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+layout(set = 0, binding = 0) uniform UniformBufferObject {
+    mat4 view;
+    mat4 proj;
+} ubo;
+
+// the chunk's TerrainSamples, a half float height in the low 16 bits and
+// the octahedral normal in the high two bytes
+layout(set = 1, binding = 0) readonly buffer Heightmap {
+    uint samples[];
+} heightmap;
+
+// samples are rows of width, step apart, starting at offset
+layout(push_constant) uniform Push {
+    ivec2 offset;
+    int width;
+    int step;
+} push;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec3 fragNormal;
+layout(location = 2) out vec3 crnPos;
+
+#include "terrain.glsl"
+
+void main() {
+    uint sample_bits = heightmap.samples[gl_VertexIndex];
+    float height = unpackHalf2x16(sample_bits).x;
+    ivec2 grid = ivec2(gl_VertexIndex % push.width, gl_VertexIndex / push.width) * push.step;
+    vec3 position = vec3(vec2(push.offset + grid), height).xzy;
+    gl_Position =  ubo.proj * ubo.view * vec4(position, 1.0);
+    crnPos = position;
+    fragColor = colorFromHeight(height);
+    fragNormal = decodeNormal(unpackSnorm4x8(sample_bits).zw);
+}
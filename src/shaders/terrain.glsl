@@ -0,0 +1,19 @@
+// helpers shared by the heightfield vertex shaders
+
+// same value as Terrain::ROCK_HEIGHT
+const float ROCK_HEIGHT = 3.5294;
+
+vec3 colorFromHeight(float height) {
+    // Terrain::WATER_HEIGHT is the only height under the flattened shore
+    if (height < 0.0) return vec3(0.0, 0.0, 1.0);
+    if (height < ROCK_HEIGHT) return vec3(0.0, 1.0, 0.0);
+    return vec3(0.5, 0.5, 0.5);
+}
+
+// inverse of TerrainSample::encodeNormal
+vec3 decodeNormal(vec2 e) {
+    vec3 n = vec3(e.x, -(1.0 - abs(e.x) - abs(e.y)), e.y);
+    if (n.y > 0.0)
+        n.xz = (1.0 - abs(e.yx)) * vec2(e.x < 0.0 ? -1.0 : 1.0, e.y < 0.0 ? -1.0 : 1.0);
+    return normalize(n);
+}
@@ -0,0 +1,31 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 view;
+    mat4 proj;
+} ubo;
+
+// world position of the chunk's first vertex
+layout(push_constant) uniform Push {
+    ivec2 offset;
+} push;
+
+// packed TerrainVertex
+layout(location = 0) in uvec2 inGrid;
+layout(location = 1) in float inHeight;
+layout(location = 2) in vec2 inNormal;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec3 fragNormal;
+layout(location = 2) out vec3 crnPos;
+
+#include "terrain.glsl"
+
+void main() {
+    vec3 position = vec3(vec2(push.offset) + vec2(inGrid), inHeight).xzy;
+    gl_Position =  ubo.proj * ubo.view * vec4(position, 1.0);
+    crnPos = position;
+    fragColor = colorFromHeight(inHeight);
+    fragNormal = decodeNormal(inNormal);
+}
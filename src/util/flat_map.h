@@ -0,0 +1,163 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <utility>
+#include <vector>
+
+namespace evn_util {
+	// two grid coordinates as one key, and back
+	inline uint64_t packCoords(int32_t x, int32_t y)
+	{
+		return ((uint64_t)(uint32_t)x << 32) | (uint32_t)y;
+	}
+	inline void unpackCoords(uint64_t key, int32_t& x, int32_t& y)
+	{
+		x = (int32_t)(uint32_t)(key >> 32);
+		y = (int32_t)(uint32_t)key;
+	}
+
+	// hash map from 64 bit keys, open addressing with linear probing over
+	// one array. erase shifts the entries probing past the hole back into
+	// it rather than leaving a tombstone, so probes stay short however many
+	// keys come and go. growing the table and erasing move the values, so
+	// pointers and references to them only last until the next of either.
+	// Value has to be default constructible and movable
+	template<typename Value>
+	class FlatMap {
+	public:
+		struct Slot {
+			uint64_t key{ 0 };
+			Value value{};
+			bool used{ false };
+		};
+
+		// visits the used slots in table order
+		template<typename SlotType>
+		class Iterator {
+		public:
+			Iterator(SlotType* slot, SlotType* end) : p_slot(slot), p_end(end) { skip(); }
+			inline SlotType& operator*() const { return *p_slot; }
+			inline SlotType* operator->() const { return p_slot; }
+			inline Iterator& operator++() { p_slot++; skip(); return *this; }
+			inline bool operator!=(const Iterator& other) const { return p_slot != other.p_slot; }
+		private:
+			inline void skip() { while (p_slot != p_end && !p_slot->used) p_slot++; }
+			SlotType* p_slot;
+			SlotType* p_end;
+		};
+
+		// the capacity is rounded up to a power of two
+		explicit FlatMap(size_t capacity = 64)
+			: m_size(0)
+		{
+			size_t size{ 8 };
+			while (size < capacity)
+				size *= 2;
+			m_slots.resize(size);
+			m_mask = size - 1;
+		}
+
+		Value* find(uint64_t key)
+		{
+			Slot& slot{ m_slots[probe(key)] };
+			return slot.used ? &slot.value : nullptr;
+		}
+		const Value* find(uint64_t key) const
+		{
+			const Slot& slot{ m_slots[probe(key)] };
+			return slot.used ? &slot.value : nullptr;
+		}
+
+		// the value for key, default constructed if there wasn't one
+		Value& operator[](uint64_t key)
+		{
+			size_t index{ probe(key) };
+			if (m_slots[index].used)
+				return m_slots[index].value;
+			if ((m_size + 1) * MAX_LOAD_DEN > m_slots.size() * MAX_LOAD_NUM) {
+				grow();
+				index = probe(key);
+			}
+			Slot& slot{ m_slots[index] };
+			slot.key = key;
+			slot.used = true;
+			m_size++;
+			return slot.value;
+		}
+
+		bool erase(uint64_t key)
+		{
+			size_t hole{ probe(key) };
+			if (!m_slots[hole].used)
+				return false;
+			// move back every entry after the hole whose home isn't between
+			// the two, it would no longer be found past the hole otherwise
+			for (size_t next{ (hole + 1) & m_mask }; m_slots[next].used; next = (next + 1) & m_mask) {
+				size_t home{ hash(m_slots[next].key) & m_mask };
+				bool stays{ hole <= next ? (hole < home && home <= next) : (hole < home || home <= next) };
+				if (stays)
+					continue;
+				m_slots[hole] = std::move(m_slots[next]);
+				hole = next;
+			}
+			// the value goes now rather than whenever the slot is reused
+			m_slots[hole] = Slot{};
+			m_size--;
+			return true;
+		}
+
+		void clear()
+		{
+			for (Slot& slot : m_slots)
+				slot = Slot{};
+			m_size = 0;
+		}
+
+		inline size_t size() const { return m_size; }
+		inline bool empty() const { return m_size == 0; }
+		inline Iterator<Slot> begin() { return { m_slots.data(), m_slots.data() + m_slots.size() }; }
+		inline Iterator<Slot> end() { return { m_slots.data() + m_slots.size(), m_slots.data() + m_slots.size() }; }
+		inline Iterator<const Slot> begin() const { return { m_slots.data(), m_slots.data() + m_slots.size() }; }
+		inline Iterator<const Slot> end() const
+		{
+			return { m_slots.data() + m_slots.size(), m_slots.data() + m_slots.size() };
+		}
+	public:
+		// grows past 7/10 full
+		const static size_t MAX_LOAD_NUM = 7;
+		const static size_t MAX_LOAD_DEN = 10;
+	private:
+		// murmur3's finaliser, packed coordinates only differ in a few low
+		// bits of each half
+		static inline uint64_t hash(uint64_t key)
+		{
+			key ^= key >> 33;
+			key *= 0xff51afd7ed558ccdull;
+			key ^= key >> 33;
+			key *= 0xc4ceb9fe1a85ec53ull;
+			key ^= key >> 33;
+			return key;
+		}
+		// the slot holding key, or the empty one it would go in
+		size_t probe(uint64_t key) const
+		{
+			size_t index{ hash(key) & m_mask };
+			while (m_slots[index].used && m_slots[index].key != key)
+				index = (index + 1) & m_mask;
+			return index;
+		}
+		void grow()
+		{
+			std::vector<Slot> old(m_slots.size() * 2);
+			old.swap(m_slots);
+			m_mask = m_slots.size() - 1;
+			for (Slot& slot : old)
+				if (slot.used)
+					m_slots[probe(slot.key)] = std::move(slot);
+		}
+	private:
+		std::vector<Slot> m_slots;
+		size_t m_mask;
+		size_t m_size;
+	};
+}
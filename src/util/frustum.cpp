@@ -0,0 +1,44 @@
+#include "frustum.h"
+
+namespace evn_util {
+	Frustum::Frustum()
+	{
+		// 0x + 0y + 0z + 1 >= 0 everywhere
+		m_planes.fill(glm::vec4{ 0.0f, 0.0f, 0.0f, 1.0f });
+	}
+
+	Frustum::Frustum(const glm::mat4& view_proj)
+	{
+		// glm is column major, row i of the matrix is m[0][i] .. m[3][i]
+		auto row = [&](int i) {
+			return glm::vec4{ view_proj[0][i], view_proj[1][i], view_proj[2][i], view_proj[3][i] };
+		};
+		glm::vec4 x{ row(0) };
+		glm::vec4 y{ row(1) };
+		glm::vec4 z{ row(2) };
+		glm::vec4 w{ row(3) };
+		// -w <= x, y <= w. the near plane is taken at z >= -w, which holds
+		// for both depth ranges and is only looser with vulkan's 0 to 1
+		m_planes[0] = w + x;
+		m_planes[1] = w - x;
+		m_planes[2] = w + y;
+		m_planes[3] = w - y;
+		m_planes[4] = w + z;
+		m_planes[5] = w - z;
+	}
+
+	bool Frustum::intersects(const Aabb& box) const
+	{
+		for (const glm::vec4& plane : m_planes) {
+			// the corner furthest along the normal, if even that is behind
+			// the plane the whole box is
+			glm::vec3 corner{
+				plane.x >= 0.0f ? box.max.x : box.min.x,
+				plane.y >= 0.0f ? box.max.y : box.min.y,
+				plane.z >= 0.0f ? box.max.z : box.min.z };
+			if (plane.x * corner.x + plane.y * corner.y + plane.z * corner.z + plane.w < 0.0f)
+				return false;
+		}
+		return true;
+	}
+}
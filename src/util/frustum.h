@@ -0,0 +1,28 @@
+#pragma once
+#include <array>
+#include <glm/glm.hpp>
+
+namespace evn_util {
+	// axis aligned box in world space
+	struct Aabb {
+		glm::vec3 min;
+		glm::vec3 max;
+	};
+
+	// the six planes bounding what a view projection matrix can see, with
+	// their normals pointing inwards
+	class Frustum {
+	public:
+		// sees everything until it is given a matrix
+		Frustum();
+		// planes from the rows of view_proj (Gribb and Hartmann)
+		explicit Frustum(const glm::mat4& view_proj);
+		// false only when the box is entirely outside one of the planes. a
+		// box outside near a corner passes, which costs a draw but never a
+		// missing chunk
+		bool intersects(const Aabb& box) const;
+	private:
+		// xyz the normal, w the distance along it to the origin
+		std::array<glm::vec4, 6> m_planes;
+	};
+}
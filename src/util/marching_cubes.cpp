@@ -0,0 +1,250 @@
+#include "marching_cubes.h"
+#include <math.h>
+#include <algorithm>
+#include <thread>
+
+namespace evn_util {
+	namespace {
+		// corner c of a cell sits at (c & 1, c >> 1 & 1, c >> 2 & 1). edges
+		// are grouped by axis and always go from the lower corner to the upper
+		const int EDGE_CORNERS[12][2]{
+			{ 0, 1 }, { 2, 3 }, { 4, 5 }, { 6, 7 },
+			{ 0, 2 }, { 1, 3 }, { 4, 6 }, { 5, 7 },
+			{ 0, 4 }, { 1, 5 }, { 2, 6 }, { 3, 7 }
+		};
+
+		inline int cornerOffset(int corner, int axis) { return corner >> axis & 1; }
+
+		// triangles of every inside/outside corner configuration, three cell
+		// edges per triangle
+		struct CaseTable {
+			std::vector<uint8_t> triangles[256];
+		};
+
+		// builds the cases instead of listing them. on every face of the cell
+		// a segment joins the edge where the surface leaves a run of inside
+		// corners to the edge where it entered it, so faces with two diagonal
+		// inside corners always keep them apart and neighbouring cells agree
+		// on the shared face. the segments chain into closed loops which are
+		// fanned into triangles
+		CaseTable buildCases(bool flip)
+		{
+			int edge_of[8][8];
+			for (int e{ 0 }; e < 12; e++) {
+				edge_of[EDGE_CORNERS[e][0]][EDGE_CORNERS[e][1]] = e;
+				edge_of[EDGE_CORNERS[e][1]][EDGE_CORNERS[e][0]] = e;
+			}
+
+			// corners of each face counter clockwise seen from outside the cell
+			int faces[6][4];
+			for (int axis{ 0 }; axis < 3; axis++) {
+				for (int side{ 0 }; side < 2; side++) {
+					int u{ (axis + 1) % 3 };
+					int v{ (axis + 2) % 3 };
+					int* ring{ faces[axis * 2 + side] };
+					int n{ 0 };
+					for (int c{ 0 }; c < 8; c++)
+						if (cornerOffset(c, axis) == side) ring[n++] = c;
+					auto angle = [&](int c) {
+						return atan2f(cornerOffset(c, v) - 0.5f, cornerOffset(c, u) - 0.5f);
+					};
+					// u x v is the +axis direction, the low face looks the other way
+					std::sort(ring, ring + 4, [&](int a, int b) {
+						return side ? angle(a) < angle(b) : angle(a) > angle(b);
+					});
+				}
+			}
+
+			CaseTable table;
+			for (int config{ 0 }; config < 256; config++) {
+				auto inside = [&](int c) { return (config >> c & 1) != 0; };
+				int next[12];
+				std::fill(next, next + 12, -1);
+				for (const int* ring : faces) {
+					for (int k{ 0 }; k < 4; k++) {
+						int a{ ring[k] };
+						int b{ ring[(k + 1) % 4] };
+						if (!inside(a) || inside(b)) continue;
+						// walk back to the edge that started this run
+						int j{ (k + 3) % 4 };
+						while (inside(ring[j]) || !inside(ring[(j + 1) % 4]))
+							j = (j + 3) % 4;
+						next[edge_of[a][b]] = edge_of[ring[j]][ring[(j + 1) % 4]];
+					}
+				}
+
+				bool visited[12]{};
+				for (int start{ 0 }; start < 12; start++) {
+					if (next[start] < 0 || visited[start]) continue;
+					std::vector<int> loop;
+					for (int e{ start }; !visited[e]; e = next[e]) {
+						visited[e] = true;
+						loop.push_back(e);
+					}
+					for (size_t i{ 1 }; i + 1 < loop.size(); i++) {
+						table.triangles[config].push_back((uint8_t)loop[0]);
+						table.triangles[config].push_back((uint8_t)loop[flip ? i + 1 : i]);
+						table.triangles[config].push_back((uint8_t)loop[flip ? i : i + 1]);
+					}
+				}
+			}
+			return table;
+		}
+
+		const CaseTable& caseTable()
+		{
+			static const CaseTable table{ [] {
+				// the loop direction follows from the face order, check it once
+				// on a lone inside corner and flip so normals face the solid
+				CaseTable cases{ buildCases(false) };
+				glm::vec3 p[3];
+				for (int i{ 0 }; i < 3; i++) {
+					const int* edge{ EDGE_CORNERS[cases.triangles[1][i]] };
+					for (int axis{ 0 }; axis < 3; axis++)
+						p[i][axis] = (cornerOffset(edge[0], axis) + cornerOffset(edge[1], axis)) * 0.5f;
+				}
+				glm::vec3 normal{ glm::cross(p[1] - p[0], p[2] - p[0]) };
+				glm::vec3 to_corner{ -(p[0] + p[1] + p[2]) / 3.0f };
+				return glm::dot(normal, to_corner) > 0 ? cases : buildCases(true);
+			}() };
+			return table;
+		}
+	}
+
+	void parallelFor(int begin, int end, unsigned threads, const std::function<void(int, int)>& work)
+	{
+		int count{ end - begin };
+		if (count <= 0) return;
+		if (threads == 0)
+			threads = std::max(1u, std::thread::hardware_concurrency());
+		int parts{ std::min((int)threads, count) };
+
+		std::vector<std::thread> workers;
+		for (int i{ 0 }; i < parts - 1; i++)
+			workers.emplace_back(work, begin + count * i / parts, begin + count * (i + 1) / parts);
+		work(begin + count * (parts - 1) / parts, end);
+		for (auto& worker : workers)
+			worker.join();
+	}
+
+	void marchingCubes(const DensityField& field, float iso, IsoMesh& mesh, unsigned threads)
+	{
+		mesh.positions.clear();
+		mesh.normals.clear();
+		mesh.indices.clear();
+		if (field.cells_x <= 0 || field.cells_y <= 0 || field.cells_z <= 0)
+			return;
+
+		const CaseTable& cases{ caseTable() };
+		const float* d{ field.values };
+		int px{ field.pointsX() };
+		int py{ field.pointsY() };
+		int pz{ field.pointsZ() };
+		size_t points{ (size_t)px * py * pz };
+		if (threads == 0)
+			threads = std::max(1u, std::thread::hardware_concurrency());
+		int slabs{ std::min((int)threads, field.cells_z) };
+
+		// density gradient at a point, one sided on the border
+		auto gradient = [&](int x, int y, int z) {
+			int x0{ std::max(x - 1, 0) }, x1{ std::min(x + 1, px - 1) };
+			int y0{ std::max(y - 1, 0) }, y1{ std::min(y + 1, py - 1) };
+			int z0{ std::max(z - 1, 0) }, z1{ std::min(z + 1, pz - 1) };
+			return glm::vec3{
+				(d[field.index(x1, y, z)] - d[field.index(x0, y, z)]) / (float)(x1 - x0),
+				(d[field.index(x, y1, z)] - d[field.index(x, y0, z)]) / (float)(y1 - y0),
+				(d[field.index(x, y, z1)] - d[field.index(x, y, z0)]) / (float)(z1 - z0)
+			};
+		};
+
+		// pass one, a vertex on every crossed edge. the edges leaving a point
+		// in +x, +y and +z belong to that point, so each point plane and the
+		// slab holding it own their edges and nothing is created twice.
+		// edge_vertex holds the index inside the owning slab
+		std::vector<int32_t> edge_vertex[3];
+		for (auto& edges : edge_vertex)
+			edges.resize(points);
+		std::vector<int> plane_slab(pz);
+		std::vector<IsoMesh> slab_vertices(slabs);
+		for (int s{ 0 }; s < slabs; s++)
+			for (int z{ pz * s / slabs }; z < pz * (s + 1) / slabs; z++)
+				plane_slab[z] = s;
+
+		parallelFor(0, slabs, slabs, [&](int first, int last) {
+			for (int s{ first }; s < last; s++) {
+				IsoMesh& out{ slab_vertices[s] };
+				for (int z{ pz * s / slabs }; z < pz * (s + 1) / slabs; z++) {
+					for (int y{ 0 }; y < py; y++) {
+						for (int x{ 0 }; x < px; x++) {
+							size_t p{ field.index(x, y, z) };
+							bool solid{ d[p] > iso };
+							int neighbour[3][3]{ { x + 1, y, z }, { x, y + 1, z }, { x, y, z + 1 } };
+							for (int axis{ 0 }; axis < 3; axis++) {
+								edge_vertex[axis][p] = -1;
+								const int* n{ neighbour[axis] };
+								if (n[0] >= px || n[1] >= py || n[2] >= pz) continue;
+								size_t q{ field.index(n[0], n[1], n[2]) };
+								if ((d[q] > iso) == solid) continue;
+
+								float t{ (iso - d[p]) / (d[q] - d[p]) };
+								glm::vec3 pos{ (float)x, (float)y, (float)z };
+								pos[axis] += t;
+								glm::vec3 normal{ gradient(x, y, z) * (1.0f - t) + gradient(n[0], n[1], n[2]) * t };
+								float length{ glm::length(normal) };
+								edge_vertex[axis][p] = (int32_t)out.positions.size();
+								out.positions.push_back(pos);
+								out.normals.push_back(length > 0.0f ? normal / length : glm::vec3{ 0, -1, 0 });
+							}
+						}
+					}
+				}
+			}
+		});
+
+		std::vector<uint32_t> slab_offset(slabs);
+		size_t vertex_count{ 0 };
+		for (int s{ 0 }; s < slabs; s++) {
+			slab_offset[s] = (uint32_t)vertex_count;
+			vertex_count += slab_vertices[s].positions.size();
+		}
+		mesh.positions.reserve(vertex_count);
+		mesh.normals.reserve(vertex_count);
+		for (const IsoMesh& slab : slab_vertices) {
+			mesh.positions.insert(mesh.positions.end(), slab.positions.begin(), slab.positions.end());
+			mesh.normals.insert(mesh.normals.end(), slab.normals.begin(), slab.normals.end());
+		}
+
+		// pass two, triangles of every cell from the shared edge vertices
+		std::vector<std::vector<uint32_t>> slab_indices(slabs);
+		int cells_z{ field.cells_z };
+		parallelFor(0, slabs, slabs, [&](int first, int last) {
+			for (int s{ first }; s < last; s++) {
+				std::vector<uint32_t>& out{ slab_indices[s] };
+				for (int z{ cells_z * s / slabs }; z < cells_z * (s + 1) / slabs; z++) {
+					for (int y{ 0 }; y < field.cells_y; y++) {
+						for (int x{ 0 }; x < field.cells_x; x++) {
+							int config{ 0 };
+							for (int c{ 0 }; c < 8; c++) {
+								size_t p{ field.index(x + cornerOffset(c, 0), y + cornerOffset(c, 1), z + cornerOffset(c, 2)) };
+								config |= (d[p] > iso) << c;
+							}
+							for (uint8_t e : cases.triangles[config]) {
+								int corner{ EDGE_CORNERS[e][0] };
+								int cz{ z + cornerOffset(corner, 2) };
+								size_t p{ field.index(x + cornerOffset(corner, 0), y + cornerOffset(corner, 1), cz) };
+								out.push_back(slab_offset[plane_slab[cz]] + (uint32_t)edge_vertex[e / 4][p]);
+							}
+						}
+					}
+				}
+			}
+		});
+
+		size_t index_count{ 0 };
+		for (const auto& indices : slab_indices)
+			index_count += indices.size();
+		mesh.indices.reserve(index_count);
+		for (const auto& indices : slab_indices)
+			mesh.indices.insert(mesh.indices.end(), indices.begin(), indices.end());
+	}
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <stdint.h>
+#include <functional>
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace evn_util {
+	// density samples on a regular grid of (cells_x + 1) * (cells_y + 1) *
+	// (cells_z + 1) points, x varying fastest. values above the iso level
+	// are solid
+	struct DensityField {
+		const float* values;
+		int cells_x;
+		int cells_y;
+		int cells_z;
+
+		inline int pointsX() const { return cells_x + 1; }
+		inline int pointsY() const { return cells_y + 1; }
+		inline int pointsZ() const { return cells_z + 1; }
+		inline size_t index(int x, int y, int z) const
+		{
+			return ((size_t)z * pointsY() + y) * pointsX() + x;
+		}
+	};
+
+	// indexed triangle mesh in grid units. normals point into the solid,
+	// the same way Terrain stores them
+	struct IsoMesh {
+		std::vector<glm::vec3> positions;
+		std::vector<glm::vec3> normals;
+		std::vector<uint32_t> indices;
+	};
+
+	// extracts the iso surface of field with marching cubes. every grid edge
+	// the surface crosses gets exactly one vertex that all four cells around
+	// it share. work is split into slabs along z and run on threads threads,
+	// 0 uses every hardware thread
+	void marchingCubes(const DensityField& field, float iso, IsoMesh& mesh, unsigned threads=0);
+
+	// runs work(begin, end) over [begin, end) split into contiguous ranges,
+	// one per thread. the last range runs on the calling thread
+	void parallelFor(int begin, int end, unsigned threads, const std::function<void(int, int)>& work);
+}
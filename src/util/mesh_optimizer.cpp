@@ -0,0 +1,132 @@
+#include "mesh_optimizer.h"
+#include <algorithm>
+
+namespace evn_util {
+	template<typename Index>
+	float averageCacheMissRatio(const Index* indices, size_t index_count, size_t vertex_count,
+		unsigned cache_size)
+	{
+		if (index_count < 3)
+			return 0.0f;
+
+		// a vertex is cached while fewer than cache_size misses came after
+		// its own, that is a FIFO without keeping the queue
+		std::vector<size_t> missed_at(vertex_count, 0);
+		size_t misses{ 0 };
+		for (size_t i{ 0 }; i < index_count; i++) {
+			Index vertex{ indices[i] };
+			if (missed_at[vertex] == 0 || misses - missed_at[vertex] >= cache_size)
+				missed_at[vertex] = ++misses;
+		}
+		return (float)misses / (float)(index_count / 3);
+	}
+
+	template<typename Index>
+	void optimizeVertexCache(Index* indices, size_t index_count, size_t vertex_count,
+		unsigned cache_size)
+	{
+		const size_t triangle_count{ index_count / 3 };
+		if (triangle_count == 0)
+			return;
+
+		// triangles around every vertex, and how many of them are left
+		std::vector<uint32_t> live(vertex_count, 0);
+		for (size_t i{ 0 }; i < triangle_count * 3; i++)
+			live[indices[i]]++;
+		std::vector<uint32_t> offsets(vertex_count + 1, 0);
+		for (size_t v{ 0 }; v < vertex_count; v++)
+			offsets[v + 1] = offsets[v] + live[v];
+		std::vector<uint32_t> adjacency(offsets[vertex_count]);
+		std::vector<uint32_t> filled(offsets.begin(), offsets.end() - 1);
+		for (size_t t{ 0 }; t < triangle_count; t++)
+			for (size_t c{ 0 }; c < 3; c++)
+				adjacency[filled[indices[t * 3 + c]]++] = (uint32_t)t;
+
+		std::vector<Index> output(triangle_count * 3);
+		size_t written{ 0 };
+		std::vector<bool> emitted(triangle_count, false);
+		// when each vertex last went into the cache, time starts past the
+		// cache size so nothing counts as cached at first
+		std::vector<size_t> cached_at(vertex_count, 0);
+		size_t time{ cache_size + (size_t)1 };
+		// vertices of emitted triangles, to restart from at dead ends
+		std::vector<Index> dead_end;
+		std::vector<Index> candidates;
+		size_t cursor{ 0 };
+
+		int64_t fan{ 0 };
+		while (fan >= 0) {
+			// emit every triangle left around the fanning vertex
+			candidates.clear();
+			for (uint32_t a{ offsets[fan] }; a < offsets[fan + 1]; a++) {
+				uint32_t t{ adjacency[a] };
+				if (emitted[t])
+					continue;
+				for (size_t c{ 0 }; c < 3; c++) {
+					Index vertex{ indices[t * 3 + c] };
+					output[written++] = vertex;
+					dead_end.push_back(vertex);
+					candidates.push_back(vertex);
+					live[vertex]--;
+					if (time - cached_at[vertex] > cache_size)
+						cached_at[vertex] = time++;
+				}
+				emitted[t] = true;
+			}
+
+			// fan around the candidate that will still be cached once its
+			// own triangles are emitted, the oldest such one first
+			fan = -1;
+			int64_t best_priority{ -1 };
+			for (Index vertex : candidates) {
+				if (live[vertex] == 0)
+					continue;
+				int64_t priority{ 0 };
+				if (time - cached_at[vertex] + 2 * live[vertex] <= cache_size)
+					priority = (int64_t)(time - cached_at[vertex]);
+				if (priority > best_priority) {
+					best_priority = priority;
+					fan = vertex;
+				}
+			}
+			if (fan >= 0)
+				continue;
+
+			// dead end, go back to a recent vertex with triangles left or
+			// else the next one in order
+			while (!dead_end.empty() && fan < 0) {
+				Index vertex{ dead_end.back() };
+				dead_end.pop_back();
+				if (live[vertex] > 0)
+					fan = vertex;
+			}
+			while (cursor < vertex_count && fan < 0) {
+				if (live[cursor] > 0)
+					fan = (int64_t)cursor;
+				cursor++;
+			}
+		}
+		std::copy(output.begin(), output.end(), indices);
+	}
+
+	template<typename Index>
+	std::vector<uint32_t> optimizeVertexFetch(Index* indices, size_t index_count, size_t vertex_count)
+	{
+		std::vector<uint32_t> remap(vertex_count, ~0u);
+		uint32_t next{ 0 };
+		for (size_t i{ 0 }; i < index_count; i++) {
+			Index vertex{ indices[i] };
+			if (remap[vertex] == ~0u)
+				remap[vertex] = next++;
+			indices[i] = (Index)remap[vertex];
+		}
+		return remap;
+	}
+
+	template float averageCacheMissRatio<uint16_t>(const uint16_t*, size_t, size_t, unsigned);
+	template float averageCacheMissRatio<uint32_t>(const uint32_t*, size_t, size_t, unsigned);
+	template void optimizeVertexCache<uint16_t>(uint16_t*, size_t, size_t, unsigned);
+	template void optimizeVertexCache<uint32_t>(uint32_t*, size_t, size_t, unsigned);
+	template std::vector<uint32_t> optimizeVertexFetch<uint16_t>(uint16_t*, size_t, size_t);
+	template std::vector<uint32_t> optimizeVertexFetch<uint32_t>(uint32_t*, size_t, size_t);
+}
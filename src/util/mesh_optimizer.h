@@ -0,0 +1,42 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+namespace evn_util {
+	// entries of the post-transform cache the orders are tuned for and
+	// measured against, about what current gpus keep per batch
+	const static unsigned VERTEX_CACHE_SIZE = 16;
+
+	// average cache miss ratio, vertex shader runs per triangle with a FIFO
+	// cache of cache_size entries. 3 is no reuse at all, a regular grid
+	// can't go below 0.5
+	template<typename Index>
+	float averageCacheMissRatio(const Index* indices, size_t index_count, size_t vertex_count,
+		unsigned cache_size = VERTEX_CACHE_SIZE);
+
+	// reorders the triangles so their vertices are still in the cache when
+	// they are used again, with tipsify (Sander, Nehab and Barczak 2007).
+	// each triangle keeps its winding
+	template<typename Index>
+	void optimizeVertexCache(Index* indices, size_t index_count, size_t vertex_count,
+		unsigned cache_size = VERTEX_CACHE_SIZE);
+
+	// renumbers the vertices in the order the indices first use them so the
+	// vertex fetches walk forwards through memory. returns the new index of
+	// every old vertex, unused ones get ~0u and are dropped by remapVertices
+	template<typename Index>
+	std::vector<uint32_t> optimizeVertexFetch(Index* indices, size_t index_count, size_t vertex_count);
+
+	template<typename Vertex>
+	void remapVertices(std::vector<Vertex>& vertices, const std::vector<uint32_t>& remap)
+	{
+		size_t used{ 0 };
+		for (uint32_t index : remap)
+			if (index != ~0u) used++;
+		std::vector<Vertex> remapped(used);
+		for (size_t i{ 0 }; i < remap.size(); i++)
+			if (remap[i] != ~0u) remapped[remap[i]] = vertices[i];
+		vertices.swap(remapped);
+	}
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <utility>
+
+namespace evn_util {
+	// bounded queue any number of threads can push to and pop from without
+	// taking a lock (Vyukov's array queue). each cell carries a sequence
+	// number saying whether it is free for the push or filled for the pop
+	// of the current lap, so a thread only ever races for the head or the
+	// tail index. T has to be default constructible
+	template<typename T>
+	class MpmcQueue {
+	public:
+		// the capacity is rounded up to a power of two
+		explicit MpmcQueue(size_t capacity)
+		{
+			size_t size{ 2 };
+			while (size < capacity)
+				size *= 2;
+			m_mask = size - 1;
+			m_cells.reset(new Cell[size]);
+			for (size_t i{ 0 }; i < size; i++)
+				m_cells[i].sequence.store(i, std::memory_order_relaxed);
+			m_head.store(0, std::memory_order_relaxed);
+			m_tail.store(0, std::memory_order_relaxed);
+		}
+		MpmcQueue(const MpmcQueue&) = delete;
+		MpmcQueue& operator=(const MpmcQueue&) = delete;
+
+		// false when the queue is full, value is left as it was
+		bool tryPush(T&& value)
+		{
+			size_t position{ m_tail.load(std::memory_order_relaxed) };
+			for (;;) {
+				Cell& cell{ m_cells[position & m_mask] };
+				size_t sequence{ cell.sequence.load(std::memory_order_acquire) };
+				intptr_t lap{ (intptr_t)sequence - (intptr_t)position };
+				if (lap == 0) {
+					if (m_tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+						cell.value = std::move(value);
+						cell.sequence.store(position + 1, std::memory_order_release);
+						return true;
+					}
+				} else if (lap < 0) {
+					// the cell still holds last lap's value
+					return false;
+				} else {
+					position = m_tail.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+		// false when the queue is empty
+		bool tryPop(T& value)
+		{
+			size_t position{ m_head.load(std::memory_order_relaxed) };
+			for (;;) {
+				Cell& cell{ m_cells[position & m_mask] };
+				size_t sequence{ cell.sequence.load(std::memory_order_acquire) };
+				intptr_t lap{ (intptr_t)sequence - (intptr_t)(position + 1) };
+				if (lap == 0) {
+					if (m_head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+						value = std::move(cell.value);
+						// leave nothing behind that would keep an object alive
+						cell.value = T{};
+						cell.sequence.store(position + m_mask + 1, std::memory_order_release);
+						return true;
+					}
+				} else if (lap < 0) {
+					return false;
+				} else {
+					position = m_head.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+		inline size_t capacity() const { return m_mask + 1; }
+	private:
+		struct alignas(64) Cell {
+			std::atomic<size_t> sequence;
+			T value;
+		};
+		std::unique_ptr<Cell[]> m_cells;
+		size_t m_mask;
+		// pushes and pops each get their own cache line
+		alignas(64) std::atomic<size_t> m_tail;
+		alignas(64) std::atomic<size_t> m_head;
+	};
+}
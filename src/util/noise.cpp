@@ -0,0 +1,35 @@
+#include "noise.h"
+#include <cmath>
+#include <random>
+
+namespace evn_util {
+	const UnitGradients& unitGradients()
+	{
+		static const UnitGradients gradients{ [] {
+			UnitGradients g{};
+			for (int i{ 0 }; i < 16; i++) {
+				double angle{ i * (3.14159265358979 / 8.0) };
+				g.x[i] = (float)sin(angle);
+				g.y[i] = (float)cos(angle);
+			}
+			return g;
+		}() };
+		return gradients;
+	}
+
+	void buildPermutation(uint32_t seed, std::vector<int32_t>& permutation)
+	{
+		// fisher-yates with mt19937 directly, std::shuffle is free to differ
+		// between standard libraries and the same seed has to give the same world
+		std::mt19937 rng(seed);
+		permutation.resize(512);
+		for (int i{ 0 }; i < 256; i++)
+			permutation[i] = i;
+		for (int i{ 255 }; i > 0; i--) {
+			int j{ (int)(rng() % (uint32_t)(i + 1)) };
+			std::swap(permutation[i], permutation[j]);
+		}
+		for (int i{ 0 }; i < 256; i++)
+			permutation[i + 256] = permutation[i];
+	}
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <limits>
+#include <vector>
+
+namespace evn_util {
+	// the noise engines the terrain can be built from
+	enum class NoiseType {
+		Perlin,
+		Simplex
+	};
+
+	// cutoff that never stops an octave sum early
+	constexpr float NO_CUTOFF{ -std::numeric_limits<float>::infinity() };
+
+	// common interface of the 2d noise engines so the terrain can pick one
+	// at construction. values are roughly in [-0.7, 0.7] for every engine
+	class NoiseEngine {
+	public:
+		virtual ~NoiseEngine() = default;
+		// single octave at (x, y) in lattice units
+		virtual float noise(float x, float y) = 0;
+		// octaves summed at (x, y) in world units, the engine's cell size
+		// sets the lowest frequency
+		virtual float octaveNoise(float x, float y, int octaves, float persistence=0.5) = 0;
+		// octaveNoise over the grid xs[0..width) x ys[0..height) into
+		// out[y * width + x]. a sample stops summing octaves once the ones
+		// left can't lift it back to cutoff, its value is then only known to
+		// be below cutoff
+		virtual void octaveNoiseGrid(const float* xs, int width, const float* ys, int height,
+			float* out, int octaves, float persistence=0.5, float cutoff=NO_CUTOFF) = 0;
+		// octaveNoise at the scattered points (x[i], y[i]) for count samples
+		virtual void octaveNoiseBatch(const float* x, const float* y, float* out, size_t count,
+			int octaves, float persistence=0.5) = 0;
+		// the same with the analytic partial derivatives of the sum along x
+		// and y, out_dx[i] and out_dy[i] line up with out[i]. values match
+		// the versions without derivatives, slopes of samples stopped by the
+		// cutoff are partial
+		virtual void octaveNoiseGridDerivatives(const float* xs, int width, const float* ys, int height,
+			float* out, float* out_dx, float* out_dy, int octaves, float persistence=0.5,
+			float cutoff=NO_CUTOFF) = 0;
+		virtual void octaveNoiseBatchDerivatives(const float* x, const float* y, float* out,
+			float* out_dx, float* out_dy, size_t count, int octaves, float persistence=0.5) = 0;
+		// largest |noise()| can reach
+		virtual float amplitude() const = 0;
+		// conservative range of octaveNoise over the box [x0, x1] x [y0, y1]
+		// without evaluating it, the true values are inside [low, high]
+		virtual void octaveNoiseBounds(float x0, float x1, float y0, float y1, int octaves,
+			float persistence, float& low, float& high) = 0;
+	};
+
+	// 16 evenly spaced unit vectors shared by the table based engines
+	struct UnitGradients {
+		float x[16];
+		float y[16];
+	};
+	const UnitGradients& unitGradients();
+
+	// seeded permutation of 0..255, doubled to 512 entries so perm[perm[x] + y]
+	// never wraps. the same seed gives the same table on every platform
+	void buildPermutation(uint32_t seed, std::vector<int32_t>& permutation);
+}
@@ -0,0 +1,711 @@
+#include "noise_graph.h"
+#include <math.h>
+#include <algorithm>
+#include <stdexcept>
+#include "scratch_arena.h"
+
+namespace evn_util {
+	// buffers for one tile. registers holds registerCount() buffers of
+	// SAMPLES floats back to back, the rest is scratch for the noise ops.
+	// the _dx and _dy buffers mirror them and are only allocated when
+	// derivatives are requested. all of them are carved from the thread's
+	// scratch arena for the length of one evaluateGrid call
+	struct NoiseGraph::Tile {
+		const static int SAMPLES = TILE_WIDTH * TILE_HEIGHT;
+
+		const float* xs;
+		const float* ys;
+		int width;
+		int height;
+		int count;
+		bool derivatives;
+		ScratchArray<float> registers;
+		ScratchArray<float> registers_dx;
+		ScratchArray<float> registers_dy;
+		ScratchArray<float> scaled_x;
+		ScratchArray<float> scaled_y;
+		ScratchArray<float> octave;
+		ScratchArray<float> octave_dx;
+		ScratchArray<float> octave_dy;
+		ScratchArray<float> weight;
+		ScratchArray<float> weight_dx;
+		ScratchArray<float> weight_dy;
+
+		inline float* reg(int index) { return registers.data() + (size_t)index * SAMPLES; }
+		inline float* regDx(int index) { return registers_dx.data() + (size_t)index * SAMPLES; }
+		inline float* regDy(int index) { return registers_dy.data() + (size_t)index * SAMPLES; }
+	};
+
+	NoiseGraph::NoiseGraph(std::shared_ptr<NoiseEngine> engine)
+		: m_engine(engine), m_output(-1), m_register_count(0), m_output_register(-1)
+	{
+		if (!m_engine)
+			throw std::runtime_error("noise graph needs an engine");
+	}
+
+	NoiseGraph::~NoiseGraph()
+	{}
+
+	NoiseNode NoiseGraph::push(Op op, int a, int b, int c, int octaves,
+		float p0, float p1, float p2, float p3)
+	{
+		for (int input : { a, b, c })
+			if (input >= (int)m_nodes.size())
+				throw std::runtime_error("noise graph node used before it was created");
+		m_nodes.push_back({ op, { a, b, c }, octaves, { p0, p1, p2, p3 } });
+		m_plan.clear();
+		return { (int)m_nodes.size() - 1 };
+	}
+
+	NoiseNode NoiseGraph::coordX() { return push(Op::CoordX); }
+	NoiseNode NoiseGraph::coordY() { return push(Op::CoordY); }
+	NoiseNode NoiseGraph::constant(float value) { return push(Op::Constant, -1, -1, -1, 0, value); }
+
+	NoiseNode NoiseGraph::fbm(NoiseNode x, NoiseNode y, int octaves, float persistence, float frequency)
+	{
+		return push(Op::Fbm, x.index, y.index, -1, octaves, persistence, frequency);
+	}
+
+	NoiseNode NoiseGraph::ridged(NoiseNode x, NoiseNode y, int octaves, float persistence,
+		float frequency, float offset, float gain)
+	{
+		return push(Op::Ridged, x.index, y.index, -1, octaves, persistence, frequency, offset, gain);
+	}
+
+	NoiseNode NoiseGraph::add(NoiseNode a, NoiseNode b) { return push(Op::Add, a.index, b.index); }
+	NoiseNode NoiseGraph::mul(NoiseNode a, NoiseNode b) { return push(Op::Mul, a.index, b.index); }
+	NoiseNode NoiseGraph::min(NoiseNode a, NoiseNode b) { return push(Op::Min, a.index, b.index); }
+	NoiseNode NoiseGraph::max(NoiseNode a, NoiseNode b) { return push(Op::Max, a.index, b.index); }
+
+	NoiseNode NoiseGraph::scaleBias(NoiseNode a, float scale, float bias)
+	{
+		return push(Op::ScaleBias, a.index, -1, -1, 0, scale, bias);
+	}
+
+	NoiseNode NoiseGraph::clamp(NoiseNode a, float low, float high)
+	{
+		return push(Op::Clamp, a.index, -1, -1, 0, low, high);
+	}
+
+	NoiseNode NoiseGraph::terrace(NoiseNode a, int steps, float smoothness)
+	{
+		return push(Op::Terrace, a.index, -1, -1, std::max(1, steps),
+			std::min(std::max(smoothness, 1e-3f), 1.0f));
+	}
+
+	NoiseNode NoiseGraph::blend(NoiseNode a, NoiseNode b, NoiseNode t)
+	{
+		return push(Op::Blend, a.index, b.index, t.index);
+	}
+
+	NoiseNode NoiseGraph::select(NoiseNode a, NoiseNode b, NoiseNode control, float threshold, float falloff)
+	{
+		return push(Op::Select, a.index, b.index, control.index, 0, threshold, std::max(falloff, 1e-6f));
+	}
+
+	std::pair<NoiseNode, NoiseNode> NoiseGraph::domainWarp(NoiseNode x, NoiseNode y, float strength,
+		int octaves, float frequency)
+	{
+		// the two offsets sample the noise far apart so they don't correlate
+		NoiseNode shifted_x{ scaleBias(x, 1.0f, 5200.0f) };
+		NoiseNode shifted_y{ scaleBias(y, 1.0f, 1300.0f) };
+		NoiseNode offset_x{ scaleBias(fbm(x, shifted_y, octaves, 0.5f, frequency), strength, 0.0f) };
+		NoiseNode offset_y{ scaleBias(fbm(shifted_x, y, octaves, 0.5f, frequency), strength, 0.0f) };
+		return { add(x, offset_x), add(y, offset_y) };
+	}
+
+	void NoiseGraph::setOutput(NoiseNode node)
+	{
+		if (node.index < 0 || node.index >= (int)m_nodes.size())
+			throw std::runtime_error("invalid noise graph output");
+		m_output = node.index;
+		m_plan.clear();
+	}
+
+	void NoiseGraph::compile()
+	{
+		if (m_output < 0)
+			throw std::runtime_error("noise graph has no output");
+
+		// noise straight on the sample position reads the tile grid itself,
+		// so its coordinate inputs are never evaluated
+		std::vector<uint8_t> regular(m_nodes.size(), 0);
+		for (size_t i{ 0 }; i < m_nodes.size(); i++) {
+			const Node& node{ m_nodes[i] };
+			if (node.op == Op::Fbm || node.op == Op::Ridged)
+				regular[i] = m_nodes[node.inputs[0]].op == Op::CoordX && m_nodes[node.inputs[1]].op == Op::CoordY;
+		}
+		auto input = [&](int node, int i) { return regular[node] ? -1 : m_nodes[node].inputs[i]; };
+
+		// post order walk from the output, so every node comes after its
+		// inputs and unreachable nodes are dropped
+		std::vector<int> order;
+		std::vector<uint8_t> state(m_nodes.size(), 0);
+		std::vector<std::pair<int, int>> stack{ { m_output, 0 } };
+		while (!stack.empty()) {
+			auto& [node, next] = stack.back();
+			if (next < 3) {
+				int child{ input(node, next++) };
+				if (child >= 0 && state[child] == 0) {
+					state[child] = 1;
+					stack.push_back({ child, 0 });
+				}
+				continue;
+			}
+			state[node] = 2;
+			order.push_back(node);
+			stack.pop_back();
+		}
+
+		// last plan step reading each node, its buffer is free after that
+		std::vector<int> last_use(m_nodes.size(), -1);
+		for (int step{ 0 }; step < (int)order.size(); step++)
+			for (int i{ 0 }; i < 3; i++)
+				if (input(order[step], i) >= 0) last_use[input(order[step], i)] = step;
+
+		// linear scan. the destination is picked before the inputs are
+		// released so an op never writes the buffer it reads
+		std::vector<int> reg(m_nodes.size(), -1);
+		std::vector<int> free_registers;
+		m_plan.clear();
+		m_register_count = 0;
+		for (int step{ 0 }; step < (int)order.size(); step++) {
+			const Node& node{ m_nodes[order[step]] };
+			int dst;
+			if (free_registers.empty()) {
+				dst = m_register_count++;
+			} else {
+				dst = free_registers.back();
+				free_registers.pop_back();
+			}
+			reg[order[step]] = dst;
+
+			Instruction ins{ node.op, dst, { -1, -1, -1 }, node.octaves,
+				{ node.params[0], node.params[1], node.params[2], node.params[3] },
+				regular[order[step]] != 0 };
+			for (int i{ 0 }; i < 3; i++)
+				if (input(order[step], i) >= 0) ins.src[i] = reg[input(order[step], i)];
+			m_plan.push_back(ins);
+
+			for (int i{ 0 }; i < 3; i++) {
+				int used{ input(order[step], i) };
+				if (used >= 0 && last_use[used] == step && used != m_output) {
+					free_registers.push_back(reg[used]);
+					last_use[used] = -1;
+				}
+			}
+		}
+		m_output_register = reg[m_output];
+	}
+
+	void NoiseGraph::evaluateGrid(const float* xs, int width, const float* ys, int height, float* out,
+		float* out_dx, float* out_dy, float cutoff) const
+	{
+		if (m_plan.empty())
+			throw std::runtime_error("noise graph evaluated before compile()");
+
+		bool derivatives{ out_dx != nullptr && out_dy != nullptr };
+		// an fbm on the sample grid that only gets scaled and biased has
+		// nothing to fuse with, the engine's grid evaluator does better on
+		// the whole grid than tile by tile
+		const Instruction& first{ m_plan.front() };
+		bool lone_fbm{ first.op == Op::Fbm && first.regular && first.params[1] == 1.0f };
+		float scale{ 1.0f };
+		float bias{ 0.0f };
+		for (size_t step{ 1 }; lone_fbm && step < m_plan.size(); step++) {
+			const Instruction& ins{ m_plan[step] };
+			lone_fbm = ins.op == Op::ScaleBias && ins.src[0] == m_plan[step - 1].dst;
+			scale *= ins.params[0];
+			bias = bias * ins.params[0] + ins.params[1];
+		}
+		if (lone_fbm) {
+			// the cutoff moves back through the scale onto the raw noise
+			float noise_cutoff{ (cutoff == NO_CUTOFF || scale <= 0.0f) ? NO_CUTOFF : (cutoff - bias) / scale };
+			if (derivatives)
+				m_engine->octaveNoiseGridDerivatives(xs, width, ys, height, out, out_dx, out_dy,
+					first.octaves, first.params[0], noise_cutoff);
+			else
+				m_engine->octaveNoiseGrid(xs, width, ys, height, out, first.octaves, first.params[0],
+					noise_cutoff);
+			if (m_plan.size() == 1) return;
+
+			// one step at a time so the values match the tiled plan
+			size_t samples{ (size_t)width * height };
+			for (size_t step{ 1 }; step < m_plan.size(); step++) {
+				const Instruction& ins{ m_plan[step] };
+				for (size_t i{ 0 }; i < samples; i++) out[i] = out[i] * ins.params[0] + ins.params[1];
+				if (!derivatives) continue;
+				for (size_t i{ 0 }; i < samples; i++) {
+					out_dx[i] *= ins.params[0];
+					out_dy[i] *= ins.params[0];
+				}
+			}
+			return;
+		}
+
+		ScratchArena& arena{ ScratchArena::local() };
+		ScratchArena::Scope scope{ arena };
+		Tile tile{};
+		tile.derivatives = derivatives;
+		tile.registers = arena.allocate<float>((size_t)m_register_count * Tile::SAMPLES);
+		tile.scaled_x = arena.allocate<float>(Tile::SAMPLES);
+		tile.scaled_y = arena.allocate<float>(Tile::SAMPLES);
+		tile.octave = arena.allocate<float>(Tile::SAMPLES);
+		tile.weight = arena.allocate<float>(Tile::SAMPLES);
+		if (tile.derivatives) {
+			tile.registers_dx = arena.allocate<float>(tile.registers.size());
+			tile.registers_dy = arena.allocate<float>(tile.registers.size());
+			tile.octave_dx = arena.allocate<float>(Tile::SAMPLES);
+			tile.octave_dy = arena.allocate<float>(Tile::SAMPLES);
+			tile.weight_dx = arena.allocate<float>(Tile::SAMPLES);
+			tile.weight_dy = arena.allocate<float>(Tile::SAMPLES);
+		}
+
+		for (int ty{ 0 }; ty < height; ty += TILE_HEIGHT) {
+			for (int tx{ 0 }; tx < width; tx += TILE_WIDTH) {
+				tile.xs = xs + tx;
+				tile.ys = ys + ty;
+				tile.width = std::min(TILE_WIDTH, width - tx);
+				tile.height = std::min(TILE_HEIGHT, height - ty);
+				tile.count = tile.width * tile.height;
+
+				for (const Instruction& ins : m_plan) {
+					execute(ins, tile);
+					if (tile.derivatives && ins.op != Op::Fbm && ins.op != Op::Ridged)
+						differentiate(ins, tile);
+				}
+
+				auto copyOut = [&](const float* result, float* dst) {
+					for (int y{ 0 }; y < tile.height; y++)
+						std::copy(result + y * tile.width, result + (y + 1) * tile.width,
+							dst + (size_t)(ty + y) * width + tx);
+				};
+				copyOut(tile.reg(m_output_register), out);
+				if (tile.derivatives) {
+					copyOut(tile.regDx(m_output_register), out_dx);
+					copyOut(tile.regDy(m_output_register), out_dy);
+				}
+			}
+		}
+	}
+
+	void NoiseGraph::bounds(float x0, float x1, float y0, float y1, float& low, float& high) const
+	{
+		if (m_plan.empty())
+			throw std::runtime_error("noise graph bounded before compile()");
+
+		// below() calls this for every box it splits, keep it off the heap
+		ScratchArena& arena{ ScratchArena::local() };
+		ScratchArena::Scope scope{ arena };
+		ScratchArray<Range> ranges{ arena.allocate<Range>(m_register_count) };
+		for (const Instruction& ins : m_plan)
+			ranges[ins.dst] = bound(ins, ranges.data(), x0, x1, y0, y1);
+		low = ranges[m_output_register].low;
+		high = ranges[m_output_register].high;
+	}
+
+	bool NoiseGraph::below(float x0, float x1, float y0, float y1, float level) const
+	{
+		return below(x0, x1, y0, y1, level, 0);
+	}
+
+	bool NoiseGraph::below(float x0, float x1, float y0, float y1, float level, int depth) const
+	{
+		float low, high;
+		bounds(x0, x1, y0, y1, low, high);
+		if (high < level) return true;
+		if (low >= level || depth == BOUND_DEPTH) return false;
+
+		// smaller boxes cover fewer lattice cells, so the bounds tighten
+		float mx{ (x0 + x1) * 0.5f };
+		float my{ (y0 + y1) * 0.5f };
+		return below(x0, mx, y0, my, level, depth + 1) && below(mx, x1, y0, my, level, depth + 1)
+			&& below(x0, mx, my, y1, level, depth + 1) && below(mx, x1, my, y1, level, depth + 1);
+	}
+
+	NoiseGraph::Range NoiseGraph::bound(const Instruction& ins, const Range* ranges,
+		float x0, float x1, float y0, float y1) const
+	{
+		Range a{ ins.src[0] >= 0 ? ranges[ins.src[0]] : Range{ 0.0f, 0.0f } };
+		Range b{ ins.src[1] >= 0 ? ranges[ins.src[1]] : Range{ 0.0f, 0.0f } };
+		Range c{ ins.src[2] >= 0 ? ranges[ins.src[2]] : Range{ 0.0f, 0.0f } };
+		auto product = [](Range p, Range q) {
+			float v[4]{ p.low * q.low, p.low * q.high, p.high * q.low, p.high * q.high };
+			return Range{ *std::min_element(v, v + 4), *std::max_element(v, v + 4) };
+		};
+		// a + (b - a) * t as a weighted sum, t in [0, 1]
+		auto mix = [&](Range t) {
+			Range inv_t{ 1.0f - t.high, 1.0f - t.low };
+			Range pa{ product(inv_t, a) };
+			Range pb{ product(t, b) };
+			return Range{ pa.low + pb.low, pa.high + pb.high };
+		};
+		auto clamp01 = [](float v) { return std::min(std::max(v, 0.0f), 1.0f); };
+
+		// the box the engine sees, after the fabs and the frequency
+		float frequency{ ins.params[1] };
+		Range bx{ x0 * frequency, x1 * frequency };
+		Range by{ y0 * frequency, y1 * frequency };
+		if (!ins.regular && (ins.op == Op::Fbm || ins.op == Op::Ridged)) {
+			auto scaled = [&](Range r) {
+				float lo{ fabsf(r.low * frequency) };
+				float hi{ fabsf(r.high * frequency) };
+				if (r.low <= 0.0f && r.high >= 0.0f) return Range{ 0.0f, std::max(lo, hi) };
+				return Range{ std::min(lo, hi), std::max(lo, hi) };
+			};
+			bx = scaled(a);
+			by = scaled(b);
+		}
+
+		switch (ins.op) {
+		case Op::CoordX:
+			return { x0, x1 };
+		case Op::CoordY:
+			return { y0, y1 };
+		case Op::Constant:
+			return { ins.params[0], ins.params[0] };
+		case Op::Fbm: {
+			Range r;
+			m_engine->octaveNoiseBounds(bx.low, bx.high, by.low, by.high, ins.octaves, ins.params[0],
+				r.low, r.high);
+			return r;
+		}
+		case Op::Ridged: {
+			// same recurrence as ridged(), one octave bound at a time
+			float offset{ ins.params[2] };
+			float gain{ ins.params[3] };
+			float amp{ 1 };
+			Range weight{ 1.0f, 1.0f };
+			Range sum{ 0.0f, 0.0f };
+			for (int o{ 0 }; o < ins.octaves; o++) {
+				Range n;
+				m_engine->octaveNoiseBounds(bx.low, bx.high, by.low, by.high, 1, 0.5f, n.low, n.high);
+				Range magnitude{ (n.low <= 0.0f && n.high >= 0.0f) ? 0.0f : std::min(fabsf(n.low), fabsf(n.high)),
+					std::max(fabsf(n.low), fabsf(n.high)) };
+				Range crest{ offset - magnitude.high, offset - magnitude.low };
+				Range signal{ product(product(crest, crest), weight) };
+				signal.low = std::max(signal.low, 0.0f);
+				Range gained{ product(signal, { gain, gain }) };
+				weight = { clamp01(gained.low), clamp01(gained.high) };
+				Range added{ product(signal, { amp, amp }) };
+				sum = { sum.low + added.low, sum.high + added.high };
+				amp *= ins.params[0];
+				bx = { bx.low * 2, bx.high * 2 };
+				by = { by.low * 2, by.high * 2 };
+			}
+			return sum;
+		}
+		case Op::Add:
+			return { a.low + b.low, a.high + b.high };
+		case Op::Mul:
+			return product(a, b);
+		case Op::Min:
+			return { std::min(a.low, b.low), std::min(a.high, b.high) };
+		case Op::Max:
+			return { std::max(a.low, b.low), std::max(a.high, b.high) };
+		case Op::ScaleBias: {
+			Range scaled{ product(a, { ins.params[0], ins.params[0] }) };
+			return { scaled.low + ins.params[1], scaled.high + ins.params[1] };
+		}
+		case Op::Clamp:
+			return { std::min(std::max(a.low, ins.params[0]), ins.params[1]),
+				std::min(std::max(a.high, ins.params[0]), ins.params[1]) };
+		case Op::Terrace: {
+			// the steps never go down, so the ends map to the ends
+			float steps{ (float)ins.octaves };
+			float smoothness{ ins.params[0] };
+			auto terrace = [&](float v) {
+				float t{ v * steps };
+				float level{ floorf(t) };
+				float ramp{ clamp01((t - level - (1.0f - smoothness)) / smoothness) };
+				return (level + ramp * ramp * (3.0f - 2.0f * ramp)) / steps;
+			};
+			return { terrace(a.low), terrace(a.high) };
+		}
+		case Op::Blend:
+			return mix({ clamp01(c.low), clamp01(c.high) });
+		case Op::Select: {
+			float low{ ins.params[0] - ins.params[1] };
+			float inv_width{ 0.5f / ins.params[1] };
+			auto smooth = [&](float v) {
+				float t{ clamp01((v - low) * inv_width) };
+				return t * t * (3.0f - 2.0f * t);
+			};
+			return mix({ smooth(c.low), smooth(c.high) });
+		}
+		}
+		return { 0.0f, 0.0f };
+	}
+
+	// one octave stack of the engine at the instruction's coordinates times
+	// frequency. regular instructions keep the tile as a grid
+	void NoiseGraph::octaveNoise(const Instruction& ins, Tile& tile, int octaves, float persistence,
+		float frequency, float* out, float* out_dx, float* out_dy) const
+	{
+		if (ins.regular) {
+			const float* grid_x{ tile.xs };
+			const float* grid_y{ tile.ys };
+			if (frequency != 1.0f) {
+				for (int x{ 0 }; x < tile.width; x++) tile.scaled_x[x] = tile.xs[x] * frequency;
+				for (int y{ 0 }; y < tile.height; y++) tile.scaled_y[y] = tile.ys[y] * frequency;
+				grid_x = tile.scaled_x.data();
+				grid_y = tile.scaled_y.data();
+			}
+			if (!tile.derivatives) {
+				m_engine->octaveNoiseGrid(grid_x, tile.width, grid_y, tile.height, out, octaves, persistence);
+				return;
+			}
+			m_engine->octaveNoiseGridDerivatives(grid_x, tile.width, grid_y, tile.height, out,
+				out_dx, out_dy, octaves, persistence);
+			if (frequency != 1.0f) {
+				for (int i{ 0 }; i < tile.count; i++) {
+					out_dx[i] *= frequency;
+					out_dy[i] *= frequency;
+				}
+			}
+			return;
+		}
+
+		// the engines expect positive coordinates, same as the terrain does
+		const float* x{ tile.reg(ins.src[0]) };
+		const float* y{ tile.reg(ins.src[1]) };
+		for (int i{ 0 }; i < tile.count; i++) {
+			tile.scaled_x[i] = fabsf(x[i] * frequency);
+			tile.scaled_y[i] = fabsf(y[i] * frequency);
+		}
+		if (!tile.derivatives) {
+			m_engine->octaveNoiseBatch(tile.scaled_x.data(), tile.scaled_y.data(), out, tile.count,
+				octaves, persistence);
+			return;
+		}
+		m_engine->octaveNoiseBatchDerivatives(tile.scaled_x.data(), tile.scaled_y.data(), out,
+			out_dx, out_dy, tile.count, octaves, persistence);
+
+		// chain rule back through the fabs, the frequency and the input
+		// coordinates' own derivatives
+		const float* x_dx{ tile.regDx(ins.src[0]) };
+		const float* x_dy{ tile.regDy(ins.src[0]) };
+		const float* y_dx{ tile.regDx(ins.src[1]) };
+		const float* y_dy{ tile.regDy(ins.src[1]) };
+		for (int i{ 0 }; i < tile.count; i++) {
+			float du{ out_dx[i] * (x[i] < 0.0f ? -frequency : frequency) };
+			float dv{ out_dy[i] * (y[i] < 0.0f ? -frequency : frequency) };
+			out_dx[i] = du * x_dx[i] + dv * y_dx[i];
+			out_dy[i] = du * x_dy[i] + dv * y_dy[i];
+		}
+	}
+
+	void NoiseGraph::ridged(const Instruction& ins, Tile& tile) const
+	{
+		float* dst{ tile.reg(ins.dst) };
+		float* dst_dx{ tile.derivatives ? tile.regDx(ins.dst) : nullptr };
+		float* dst_dy{ tile.derivatives ? tile.regDy(ins.dst) : nullptr };
+		float persistence{ ins.params[0] };
+		float frequency{ ins.params[1] };
+		float offset{ ins.params[2] };
+		float gain{ ins.params[3] };
+		float amp{ 1 };
+		int n{ tile.count };
+
+		std::fill(dst, dst + n, 0.0f);
+		std::fill(tile.weight.begin(), tile.weight.begin() + n, 1.0f);
+		if (tile.derivatives) {
+			std::fill(dst_dx, dst_dx + n, 0.0f);
+			std::fill(dst_dy, dst_dy + n, 0.0f);
+			std::fill(tile.weight_dx.begin(), tile.weight_dx.begin() + n, 0.0f);
+			std::fill(tile.weight_dy.begin(), tile.weight_dy.begin() + n, 0.0f);
+		}
+
+		for (int o{ 0 }; o < ins.octaves; o++) {
+			octaveNoise(ins, tile, 1, persistence, frequency, tile.octave.data(),
+				tile.octave_dx.data(), tile.octave_dy.data());
+			for (int i{ 0 }; i < n; i++) {
+				float crest{ offset - fabsf(tile.octave[i]) };
+				float signal{ crest };
+				signal *= signal * tile.weight[i];
+				if (tile.derivatives) {
+					// signal = crest^2 * weight, crest' = -sign(noise) * noise'
+					float sign{ tile.octave[i] < 0.0f ? 1.0f : -1.0f };
+					float signal_dx{ 2.0f * crest * tile.weight[i] * sign * tile.octave_dx[i]
+						+ crest * crest * tile.weight_dx[i] };
+					float signal_dy{ 2.0f * crest * tile.weight[i] * sign * tile.octave_dy[i]
+						+ crest * crest * tile.weight_dy[i] };
+					bool clamped{ signal * gain <= 0.0f || signal * gain >= 1.0f };
+					tile.weight_dx[i] = clamped ? 0.0f : signal_dx * gain;
+					tile.weight_dy[i] = clamped ? 0.0f : signal_dy * gain;
+					dst_dx[i] += signal_dx * amp;
+					dst_dy[i] += signal_dy * amp;
+				}
+				tile.weight[i] = std::min(std::max(signal * gain, 0.0f), 1.0f);
+				dst[i] += signal * amp;
+			}
+			amp *= persistence;
+			frequency *= 2;
+		}
+	}
+
+	void NoiseGraph::execute(const Instruction& ins, Tile& tile) const
+	{
+		float* dst{ tile.reg(ins.dst) };
+		const float* a{ ins.src[0] >= 0 ? tile.reg(ins.src[0]) : nullptr };
+		const float* b{ ins.src[1] >= 0 ? tile.reg(ins.src[1]) : nullptr };
+		const float* c{ ins.src[2] >= 0 ? tile.reg(ins.src[2]) : nullptr };
+		int n{ tile.count };
+
+		switch (ins.op) {
+		case Op::CoordX:
+			for (int y{ 0 }; y < tile.height; y++)
+				std::copy(tile.xs, tile.xs + tile.width, dst + y * tile.width);
+			break;
+		case Op::CoordY:
+			for (int y{ 0 }; y < tile.height; y++)
+				std::fill(dst + y * tile.width, dst + (y + 1) * tile.width, tile.ys[y]);
+			break;
+		case Op::Constant:
+			std::fill(dst, dst + n, ins.params[0]);
+			break;
+		case Op::Fbm:
+			octaveNoise(ins, tile, ins.octaves, ins.params[0], ins.params[1], dst,
+				tile.derivatives ? tile.regDx(ins.dst) : nullptr,
+				tile.derivatives ? tile.regDy(ins.dst) : nullptr);
+			break;
+		case Op::Ridged:
+			ridged(ins, tile);
+			break;
+		case Op::Add:
+			for (int i{ 0 }; i < n; i++) dst[i] = a[i] + b[i];
+			break;
+		case Op::Mul:
+			for (int i{ 0 }; i < n; i++) dst[i] = a[i] * b[i];
+			break;
+		case Op::Min:
+			for (int i{ 0 }; i < n; i++) dst[i] = std::min(a[i], b[i]);
+			break;
+		case Op::Max:
+			for (int i{ 0 }; i < n; i++) dst[i] = std::max(a[i], b[i]);
+			break;
+		case Op::ScaleBias:
+			for (int i{ 0 }; i < n; i++) dst[i] = a[i] * ins.params[0] + ins.params[1];
+			break;
+		case Op::Clamp:
+			for (int i{ 0 }; i < n; i++) dst[i] = std::min(std::max(a[i], ins.params[0]), ins.params[1]);
+			break;
+		case Op::Terrace: {
+			float steps{ (float)ins.octaves };
+			float smoothness{ ins.params[0] };
+			for (int i{ 0 }; i < n; i++) {
+				float t{ a[i] * steps };
+				float level{ floorf(t) };
+				float ramp{ std::min(std::max((t - level - (1.0f - smoothness)) / smoothness, 0.0f), 1.0f) };
+				dst[i] = (level + ramp * ramp * (3.0f - 2.0f * ramp)) / steps;
+			}
+			break;
+		}
+		case Op::Blend:
+			for (int i{ 0 }; i < n; i++) {
+				float t{ std::min(std::max(c[i], 0.0f), 1.0f) };
+				dst[i] = a[i] + (b[i] - a[i]) * t;
+			}
+			break;
+		case Op::Select: {
+			float low{ ins.params[0] - ins.params[1] };
+			float inv_width{ 0.5f / ins.params[1] };
+			for (int i{ 0 }; i < n; i++) {
+				float t{ std::min(std::max((c[i] - low) * inv_width, 0.0f), 1.0f) };
+				t = t * t * (3.0f - 2.0f * t);
+				dst[i] = a[i] + (b[i] - a[i]) * t;
+			}
+			break;
+		}
+		}
+	}
+
+	void NoiseGraph::differentiate(const Instruction& ins, Tile& tile) const
+	{
+		float* dst_dx{ tile.regDx(ins.dst) };
+		float* dst_dy{ tile.regDy(ins.dst) };
+		const float* a{ ins.src[0] >= 0 ? tile.reg(ins.src[0]) : nullptr };
+		const float* b{ ins.src[1] >= 0 ? tile.reg(ins.src[1]) : nullptr };
+		const float* c{ ins.src[2] >= 0 ? tile.reg(ins.src[2]) : nullptr };
+		int n{ tile.count };
+
+		// the same rule runs for both axes
+		for (int axis{ 0 }; axis < 2; axis++) {
+			float* d{ axis == 0 ? dst_dx : dst_dy };
+			auto slope = [&](int src) -> const float* {
+				if (src < 0) return nullptr;
+				return axis == 0 ? tile.regDx(src) : tile.regDy(src);
+			};
+			const float* da{ slope(ins.src[0]) };
+			const float* db{ slope(ins.src[1]) };
+			const float* dc{ slope(ins.src[2]) };
+
+			switch (ins.op) {
+			case Op::CoordX:
+				std::fill(d, d + n, axis == 0 ? 1.0f : 0.0f);
+				break;
+			case Op::CoordY:
+				std::fill(d, d + n, axis == 1 ? 1.0f : 0.0f);
+				break;
+			case Op::Constant:
+				std::fill(d, d + n, 0.0f);
+				break;
+			case Op::Fbm:
+			case Op::Ridged:
+				break;
+			case Op::Add:
+				for (int i{ 0 }; i < n; i++) d[i] = da[i] + db[i];
+				break;
+			case Op::Mul:
+				for (int i{ 0 }; i < n; i++) d[i] = da[i] * b[i] + a[i] * db[i];
+				break;
+			case Op::Min:
+				for (int i{ 0 }; i < n; i++) d[i] = b[i] < a[i] ? db[i] : da[i];
+				break;
+			case Op::Max:
+				for (int i{ 0 }; i < n; i++) d[i] = a[i] < b[i] ? db[i] : da[i];
+				break;
+			case Op::ScaleBias:
+				for (int i{ 0 }; i < n; i++) d[i] = da[i] * ins.params[0];
+				break;
+			case Op::Clamp:
+				for (int i{ 0 }; i < n; i++)
+					d[i] = (a[i] < ins.params[0] || a[i] > ins.params[1]) ? 0.0f : da[i];
+				break;
+			case Op::Terrace: {
+				float steps{ (float)ins.octaves };
+				float smoothness{ ins.params[0] };
+				for (int i{ 0 }; i < n; i++) {
+					float t{ a[i] * steps };
+					float ramp{ (t - floorf(t) - (1.0f - smoothness)) / smoothness };
+					// flat on the plateaus, smoothstep slope on the ramps
+					d[i] = (ramp <= 0.0f || ramp >= 1.0f) ? 0.0f
+						: 6.0f * ramp * (1.0f - ramp) * da[i] / smoothness;
+				}
+				break;
+			}
+			case Op::Blend:
+				for (int i{ 0 }; i < n; i++) {
+					float t{ std::min(std::max(c[i], 0.0f), 1.0f) };
+					float dt{ (c[i] <= 0.0f || c[i] >= 1.0f) ? 0.0f : dc[i] };
+					d[i] = da[i] + (db[i] - da[i]) * t + (b[i] - a[i]) * dt;
+				}
+				break;
+			case Op::Select: {
+				float low{ ins.params[0] - ins.params[1] };
+				float inv_width{ 0.5f / ins.params[1] };
+				for (int i{ 0 }; i < n; i++) {
+					float t{ (c[i] - low) * inv_width };
+					float dt{ 0.0f };
+					if (t > 0.0f && t < 1.0f)
+						dt = 6.0f * t * (1.0f - t) * inv_width * dc[i];
+					t = std::min(std::max(t, 0.0f), 1.0f);
+					t = t * t * (3.0f - 2.0f * t);
+					d[i] = da[i] + (db[i] - da[i]) * t + (b[i] - a[i]) * dt;
+				}
+				break;
+			}
+			}
+		}
+	}
+}
@@ -0,0 +1,151 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "noise.h"
+
+namespace evn_util {
+	// handle to a node of a NoiseGraph
+	struct NoiseNode {
+		int index{ -1 };
+	};
+
+	// composes noise primitives and combinators into one heightfield function.
+	// compile() flattens the nodes reachable from the output into a plan of
+	// array operations over a small set of reused buffers. evaluation runs
+	// the whole plan over one tile of samples at a time, so the buffers stay
+	// in cache and every node costs one loop per tile instead of a call per
+	// sample
+	class NoiseGraph {
+	public:
+		NoiseGraph(std::shared_ptr<NoiseEngine> engine);
+		~NoiseGraph();
+
+		// the sample position being evaluated
+		NoiseNode coordX();
+		NoiseNode coordY();
+		NoiseNode constant(float value);
+
+		// primitives. frequency scales the coordinates before they reach the
+		// engine, so 1 gives the engine's own cell size
+		NoiseNode fbm(NoiseNode x, NoiseNode y, int octaves, float persistence=0.5f,
+			float frequency=1.0f);
+		// ridged multifractal, sharp crests where the noise crosses zero.
+		// each octave is weighted by the previous one times gain
+		NoiseNode ridged(NoiseNode x, NoiseNode y, int octaves, float persistence=0.5f,
+			float frequency=1.0f, float offset=1.0f, float gain=2.0f);
+
+		// combinators
+		NoiseNode add(NoiseNode a, NoiseNode b);
+		NoiseNode mul(NoiseNode a, NoiseNode b);
+		NoiseNode min(NoiseNode a, NoiseNode b);
+		NoiseNode max(NoiseNode a, NoiseNode b);
+		NoiseNode scaleBias(NoiseNode a, float scale, float bias);
+		NoiseNode clamp(NoiseNode a, float low, float high);
+		// quantises into steps plateaus, smoothness is the fraction of each
+		// step used for the ramp to the next one
+		NoiseNode terrace(NoiseNode a, int steps, float smoothness=0.3f);
+		// lerp from a to b by t clamped to [0, 1]
+		NoiseNode blend(NoiseNode a, NoiseNode b, NoiseNode t);
+		// a below threshold, b above, blended smoothly over +-falloff.
+		// used to mix biomes
+		NoiseNode select(NoiseNode a, NoiseNode b, NoiseNode control, float threshold, float falloff);
+		// coordinates pushed around by fbm noise of the given strength
+		std::pair<NoiseNode, NoiseNode> domainWarp(NoiseNode x, NoiseNode y, float strength,
+			int octaves, float frequency=1.0f);
+
+		void setOutput(NoiseNode node);
+		// builds the evaluation plan, must be called after the last change
+		void compile();
+		// evaluates the output on the grid xs[0..width) x ys[0..height) into
+		// out[y * width + x]. safe to call from several threads at once.
+		// when out_dx and out_dy are given every op also carries its partial
+		// derivatives along x and y, so they hold the output's analytic slope.
+		// when the output is a lone fbm, scaled and biased at most, samples
+		// that can't end up at cutoff or above stop early and only promise
+		// to be below it
+		void evaluateGrid(const float* xs, int width, const float* ys, int height, float* out,
+			float* out_dx=nullptr, float* out_dy=nullptr, float cutoff=NO_CUTOFF) const;
+		// conservative range of the output over the box [x0, x1] x [y0, y1],
+		// by interval arithmetic over the plan with the engine's bounds
+		void bounds(float x0, float x1, float y0, float y1, float& low, float& high) const;
+		// true when the output is below level everywhere in the box. boxes
+		// the bound can't decide are split in four, up to BOUND_DEPTH times
+		bool below(float x0, float x1, float y0, float y1, float level) const;
+
+		inline size_t planSize() const { return m_plan.size(); }
+		inline int registerCount() const { return m_register_count; }
+	public:
+		// tile every plan step runs over, 8 KB per buffer
+		const static int TILE_WIDTH = 64;
+		const static int TILE_HEIGHT = 32;
+		// splits below() may make, a 240 wide box ends in 4 unit ones
+		const static int BOUND_DEPTH = 6;
+	private:
+		enum class Op {
+			CoordX,
+			CoordY,
+			Constant,
+			Fbm,
+			Ridged,
+			Add,
+			Mul,
+			Min,
+			Max,
+			ScaleBias,
+			Clamp,
+			Terrace,
+			Blend,
+			Select
+		};
+
+		struct Node {
+			Op op;
+			int inputs[3];
+			int octaves;
+			float params[4];
+		};
+
+		// a node with its inputs and output resolved to buffers. regular
+		// noise reads the untouched sample grid so it can use the engine's
+		// grid evaluator
+		struct Instruction {
+			Op op;
+			int dst;
+			int src[3];
+			int octaves;
+			float params[4];
+			bool regular;
+		};
+
+		struct Tile;
+
+		struct Range {
+			float low;
+			float high;
+		};
+	private:
+		NoiseNode push(Op op, int a=-1, int b=-1, int c=-1, int octaves=0,
+			float p0=0.0f, float p1=0.0f, float p2=0.0f, float p3=0.0f);
+		void execute(const Instruction& ins, Tile& tile) const;
+		// derivatives of a combinator from its inputs, after execute()
+		void differentiate(const Instruction& ins, Tile& tile) const;
+		void ridged(const Instruction& ins, Tile& tile) const;
+		// out_dx and out_dy are only written when the tile has derivatives
+		void octaveNoise(const Instruction& ins, Tile& tile, int octaves, float persistence,
+			float frequency, float* out, float* out_dx, float* out_dy) const;
+		// range of one instruction from the ranges of its inputs
+		Range bound(const Instruction& ins, const Range* ranges,
+			float x0, float x1, float y0, float y1) const;
+		bool below(float x0, float x1, float y0, float y1, float level, int depth) const;
+	private:
+		std::shared_ptr<NoiseEngine> m_engine;
+		std::vector<Node> m_nodes;
+		int m_output;
+		std::vector<Instruction> m_plan;
+		int m_register_count;
+		int m_output_register;
+	};
+}
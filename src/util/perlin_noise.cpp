@@ -1,10 +1,13 @@
 #include "perlin_noise.h"
+#include "perlin_noise_simd.h"
 
 namespace evn_util {
-	PerlinNoise::PerlinNoise(uint16_t cell_dimension)
-		: m_dimensions(cell_dimension), m_mesh_dimension(256)
+	PerlinNoise::PerlinNoise(uint16_t cell_dimension, GradientMode mode, uint32_t seed)
+		: m_dimensions(cell_dimension), m_mesh_dimension(256), m_mode(mode), m_coarse_tolerance(0.0f)
 	{
 		// initCorners();
+		if (m_mode == GradientMode::Table)
+			buildPermutation(seed, m_permutation);
 	}
 
 	PerlinNoise::~PerlinNoise()
@@ -42,6 +45,49 @@ namespace evn_util {
 		// return the interpolated value in the y direction
 		return interp(u, v, sy);
 	}
+	float PerlinNoise::perlinDerivatives(float x, float y, float& dx, float& dy)
+	{
+		return sampleDerivatives(x, y, dx, dy, false);
+	}
+	float PerlinNoise::sampleDerivatives(float x, float y, float& dx, float& dy, bool batch_gradients)
+	{
+		int x0{ (int)(x) };
+		int y0{ (int)(y) };
+		float sx{ x - (float)x0 };
+		float sy{ y - (float)y0 };
+		glm::vec2 g0, g1, g2, g3;
+		if (batch_gradients && m_mode == GradientMode::Hash) {
+			simd::hashGradient(x0, y0, g0.x, g0.y);
+			simd::hashGradient(x0 + 1, y0, g1.x, g1.y);
+			simd::hashGradient(x0, y0 + 1, g2.x, g2.y);
+			simd::hashGradient(x0 + 1, y0 + 1, g3.x, g3.y);
+		} else {
+			g0 = randomGradient(x0, y0);
+			g1 = randomGradient(x0 + 1, y0);
+			g2 = randomGradient(x0, y0 + 1);
+			g3 = randomGradient(x0 + 1, y0 + 1);
+		}
+
+		// same operations as perlin() so the value matches exactly
+		float sx1{ x - (float)(x0 + 1) };
+		float sy1{ y - (float)(y0 + 1) };
+		float d0{ sx * g0.x + sy * g0.y };
+		float d1{ sx1 * g1.x + sy * g1.y };
+		float d2{ sx * g2.x + sy1 * g2.y };
+		float d3{ sx1 * g3.x + sy1 * g3.y };
+		float wx{ poly(sx) };
+		float wy{ poly(sy) };
+		float u{ linear(d0, d1, wx) };
+		float v{ linear(d2, d3, wx) };
+
+		float ux{ linear(g0.x, g1.x, wx) + polyDerivative(sx) * (d1 - d0) };
+		float vx{ linear(g2.x, g3.x, wx) + polyDerivative(sx) * (d3 - d2) };
+		float uy{ linear(g0.y, g1.y, wx) };
+		float vy{ linear(g2.y, g3.y, wx) };
+		dx = linear(ux, vx, wy);
+		dy = linear(uy, vy, wy) + polyDerivative(sy) * (v - u);
+		return linear(u, v, wy);
+	}
 	float PerlinNoise::octavePerlin(float x, float y, int octaves, float persistence)
 	{
 		float val{ 0.0f };
@@ -56,6 +102,76 @@ namespace evn_util {
 
 		return val;
 	}
+	float PerlinNoise::noise(float x, float y)
+	{
+		return perlin(x, y);
+	}
+	float PerlinNoise::octaveNoise(float x, float y, int octaves, float persistence)
+	{
+		return octavePerlin(x, y, octaves, persistence);
+	}
+	void PerlinNoise::octaveNoiseGrid(const float* xs, int width, const float* ys, int height,
+		float* out, int octaves, float persistence, float cutoff)
+	{
+		// the terrain's settings have a specialised kernel
+		if (octaves == 6 && persistence == 0.5f && m_dimensions == 16)
+			octavePerlinGrid<6, 16>(xs, width, ys, height, out, cutoff);
+		else
+			octavePerlinGrid(xs, width, ys, height, out, octaves, persistence, cutoff);
+	}
+	void PerlinNoise::octaveNoiseBatch(const float* x, const float* y, float* out, size_t count,
+		int octaves, float persistence)
+	{
+		octavePerlinBatch(x, y, out, count, octaves, persistence);
+	}
+	void PerlinNoise::octaveNoiseGridDerivatives(const float* xs, int width, const float* ys, int height,
+		float* out, float* out_dx, float* out_dy, int octaves, float persistence, float cutoff)
+	{
+		octavePerlinGridDerivatives(xs, width, ys, height, out, out_dx, out_dy, octaves, persistence,
+			cutoff);
+	}
+	void PerlinNoise::octaveNoiseBatchDerivatives(const float* x, const float* y, float* out,
+		float* out_dx, float* out_dy, size_t count, int octaves, float persistence)
+	{
+		for (size_t i{ 0 }; i < count; i++) {
+			float val{ 0.0f };
+			float dx{ 0.0f };
+			float dy{ 0.0f };
+			float freq{ 1 };
+			float amp{ 1 };
+			for (int o{ 0 }; o < octaves; o++) {
+				float gx, gy;
+				val += sampleDerivatives(x[i] * freq / m_dimensions, y[i] * freq / m_dimensions, gx, gy, true) * amp;
+				dx += gx * amp * freq / m_dimensions;
+				dy += gy * amp * freq / m_dimensions;
+				freq *= 2;
+				amp *= persistence;
+			}
+			out[i] = val;
+			out_dx[i] = dx;
+			out_dy[i] = dy;
+		}
+	}
+	void PerlinNoise::perlinBatch(const float* x, const float* y, float* out, size_t count)
+	{
+		octaveBatch(x, y, out, count, 1, 1.0f, 1.0f);
+	}
+	void PerlinNoise::octavePerlinBatch(const float* x, const float* y, float* out, size_t count,
+		int octaves, float persistence)
+	{
+		octaveBatch(x, y, out, count, octaves, persistence, (float)m_dimensions);
+	}
+	void PerlinNoise::octaveBatch(const float* x, const float* y, float* out, size_t count,
+		int octaves, float persistence, float dim)
+	{
+		if (m_mode == GradientMode::Table) {
+			const UnitGradients& gradients{ unitGradients() };
+			simd::GradientTable table{ m_permutation.data(), gradients.x, gradients.y };
+			simd::octavePerlin(x, y, out, count, octaves, persistence, dim, &table);
+		} else {
+			simd::octavePerlin(x, y, out, count, octaves, persistence, dim, nullptr);
+		}
+	}
 	void PerlinNoise::initCorners()
 	{
 		// resize the matrice to the dimensions
@@ -79,7 +195,17 @@ namespace evn_util {
 		return  (float)((a - b) * (3.0 - c * 2.0) * c * c + a);
 	}
 
-	glm::vec2 PerlinNoise::randomGradient(int ix, int iy) {
+	glm::vec2 PerlinNoise::randomGradient(int ix, int iy)
+	{
+		if (m_mode == GradientMode::Hash)
+			return hashGradient(ix, iy);
+
+		// same lookup the batch kernels do
+		int h{ m_permutation[m_permutation[ix & 255] + (iy & 255)] & 15 };
+		return { unitGradients().x[h], unitGradients().y[h] };
+	}
+
+	glm::vec2 PerlinNoise::hashGradient(int ix, int iy) {
 		// No precomputed gradients mean this works for any number of grid coordinates
 		const unsigned w = 8 * sizeof(unsigned);
 		const unsigned s = w / 2;
@@ -3,27 +3,166 @@
 #include <vector>
 #include <glm/glm.hpp>
 #include <random>
+#include <utility>
+#include "noise.h"
 
 namespace evn_util {
-	class PerlinNoise {
+	// per octave sample scale (freq / cell size) and amplitude, built at
+	// compile time for the specialised octave kernels
+	template<int Octaves, int PersistenceNum, int PersistenceDen>
+	struct OctaveTable {
+		static_assert(Octaves > 0, "need at least one octave");
+		static_assert(PersistenceDen != 0, "persistence denominator can't be zero");
+		float scale[Octaves]{};
+		float amp[Octaves]{};
+
+		constexpr OctaveTable(uint16_t cell_dimensions)
+		{
+			float f{ 1 };
+			float a{ 1 };
+			for (int i{ 0 }; i < Octaves; i++) {
+				scale[i] = f / cell_dimensions;
+				amp[i] = a;
+				f *= 2;
+				a *= (float)PersistenceNum / (float)PersistenceDen;
+			}
+		}
+	};
+
+	// how the gradient at a lattice corner is picked
+	enum class GradientMode {
+		Hash,  // integer hash turned into an angle, the original worlds
+		Table  // seeded permutation table into a fixed set of unit gradients
+	};
+
+	class PerlinNoise : public NoiseEngine {
 	public:
-		PerlinNoise(uint16_t cell_dimensions);
+		PerlinNoise(uint16_t cell_dimensions, GradientMode mode=GradientMode::Hash, uint32_t seed=0);
 		~PerlinNoise();
 		float perlin(float x, float y);
 		float octavePerlin(float x, float y, int octaves, float persistence=0.5);
+		// NoiseEngine
+		float noise(float x, float y) override;
+		float octaveNoise(float x, float y, int octaves, float persistence=0.5) override;
+		void octaveNoiseGrid(const float* xs, int width, const float* ys, int height,
+			float* out, int octaves, float persistence=0.5, float cutoff=NO_CUTOFF) override;
+		void octaveNoiseBatch(const float* x, const float* y, float* out, size_t count,
+			int octaves, float persistence=0.5) override;
+		void octaveNoiseGridDerivatives(const float* xs, int width, const float* ys, int height,
+			float* out, float* out_dx, float* out_dy, int octaves, float persistence=0.5,
+			float cutoff=NO_CUTOFF) override;
+		void octaveNoiseBatchDerivatives(const float* x, const float* y, float* out,
+			float* out_dx, float* out_dy, size_t count, int octaves, float persistence=0.5) override;
+		float amplitude() const override;
+		// per octave range over the lattice cells the box covers, from the
+		// corner gradients. octaves with too many cells in the box fall
+		// back to +-amplitude()
+		void octaveNoiseBounds(float x0, float x1, float y0, float y1, int octaves,
+			float persistence, float& low, float& high) override;
+		// batch versions, out[i] is the noise at (x[i], y[i]) for count samples.
+		// uses the widest simd kernel the cpu supports. in hash mode the gradient
+		// angle is evaluated with a polynomial so values differ from perlin() in
+		// the last few bits, table mode matches exactly. every kernel returns
+		// the same results
+		void perlinBatch(const float* x, const float* y, float* out, size_t count);
+		void octavePerlinBatch(const float* x, const float* y, float* out, size_t count,
+			int octaves, float persistence=0.5);
+		// evaluates octavePerlin on the grid xs[0..width) x ys[0..height) into
+		// out[y * width + x]. corner gradients are looked up once per lattice
+		// corner and fade weights once per row and column, the values match
+		// octavePerlin exactly. samples that can't climb back to cutoff stop
+		// early, and rows where every sample stopped skip their gradients
+		void octavePerlinGrid(const float* xs, int width, const float* ys, int height,
+			float* out, int octaves, float persistence=0.5, float cutoff=NO_CUTOFF);
+		// lets octaveNoiseGridDerivatives sum the smooth low octaves on a
+		// sub-grid every few samples and upsample them with cubic hermite
+		// splines through their exact values and slopes, as long as the
+		// expected error of the upsampled octaves stays under tolerance.
+		// only evenly spaced grids qualify, 0 turns it off. the value only
+		// grid is always exact
+		inline void setCoarseTolerance(float tolerance) { m_coarse_tolerance = tolerance; }
+		inline float coarseTolerance() const { return m_coarse_tolerance; }
+		// perlin and octavePerlinGrid with the partial derivatives of the
+		// result, from the gradients and the derivative of the fade curve
+		float perlinDerivatives(float x, float y, float& dx, float& dy);
+		void octavePerlinGridDerivatives(const float* xs, int width, const float* ys, int height,
+			float* out, float* out_dx, float* out_dy, int octaves, float persistence=0.5,
+			float cutoff=NO_CUTOFF);
+		// 3d gradient noise on the 12 cube edge directions, for volumes.
+		// unlike the 2d noise it floors the coordinates, so negative
+		// positions are fine
+		float perlin3(float x, float y, float z);
+		float octavePerlin3(float x, float y, float z, int octaves, float persistence=0.5);
+		// out[i] = octavePerlin3(x[i], y[i], z[i]), evaluated one octave at a
+		// time across the whole batch
+		void octavePerlin3Batch(const float* x, const float* y, const float* z, float* out,
+			size_t count, int octaves, float persistence=0.5);
+		// octavePerlin with the octave count, cell size and persistence
+		// (PersistenceNum / PersistenceDen) fixed at compile time. the octave
+		// loop is unrolled and the divisions by the cell size are folded into
+		// the constant table. CellSize replaces the size given at construction,
+		// results match octavePerlin exactly when it is a power of two
+		template<int Octaves, uint16_t CellSize, int PersistenceNum=1, int PersistenceDen=2>
+		inline float octavePerlin(float x, float y)
+		{
+			constexpr OctaveTable<Octaves, PersistenceNum, PersistenceDen> table(CellSize);
+			return unrolledOctaves(x, y, table, std::make_integer_sequence<int, Octaves>{});
+		}
+		template<int Octaves, uint16_t CellSize, int PersistenceNum=1, int PersistenceDen=2>
+		inline void octavePerlinGrid(const float* xs, int width, const float* ys, int height, float* out,
+			float cutoff=NO_CUTOFF)
+		{
+			constexpr OctaveTable<Octaves, PersistenceNum, PersistenceDen> table(CellSize);
+			// scale already holds the division so the grid divides by one
+			gridOctaves(xs, width, ys, height, out, nullptr, nullptr, table.scale, table.amp, Octaves,
+				1.0f, cutoff);
+		}
 		static inline float linear(float start, float end, float coef) { return coef * (end - start) + start; }
 		static inline float poly(float coef) { return 3 * coef * coef - 2 * coef * coef * coef; }
+		static inline float polyDerivative(float coef) { return 6 * coef - 6 * coef * coef; }
 		static inline float interp(float start, float end, float coef) { return linear(start, end, poly(coef)); }
 	private: // methods
 		void initCorners();
 		glm::vec2 randomGradient(int x, int y);
+		glm::vec2 hashGradient(int x, int y);
+		// index into the 16 entry table of 3d gradients
+		int gradient3(int x, int y, int z) const;
+		float dotGradient3(int x, int y, int z, float dx, float dy, float dz) const;
 		float dotGradient(int x0, int x1, float x, float y);
+		// perlinDerivatives, with the gradients the batch kernels use when
+		// batch_gradients is set so batch values match octavePerlinBatch
+		float sampleDerivatives(float x, float y, float& dx, float& dy, bool batch_gradients);
 		float ease(float a, float b, float c) const ;
+		void octaveBatch(const float* x, const float* y, float* out, size_t count,
+			int octaves, float persistence, float dim);
+		// out_dx and out_dy are only written when not null
+		void gridOctaves(const float* xs, int width, const float* ys, int height, float* out,
+			float* out_dx, float* out_dy, const float* freq, const float* amp, int octaves, float dim,
+			float cutoff);
+		// adds octaves [first, octaves) to what out already holds
+		void sumOctaves(const float* xs, int width, const float* ys, int height, float* out,
+			float* out_dx, float* out_dy, const float* freq, const float* amp, int first, int octaves,
+			float dim, float cutoff);
+		// how many of the lowest octaves can go on a sub-grid and its stride
+		// in samples, 0 octaves when the grid doesn't qualify
+		int coarseOctaves(const float* xs, int width, const float* ys, int height, const float* freq,
+			const float* amp, int octaves, float dim, int& stride) const;
+		template<typename Table, int... I>
+		inline float unrolledOctaves(float x, float y, const Table& table, std::integer_sequence<int, I...>)
+		{
+			float val{ 0.0f };
+			((val += perlin(x * table.scale[I], y * table.scale[I]) * table.amp[I]), ...);
+			return val;
+		}
 
 		
 	private:
 		uint16_t m_dimensions;
 		uint32_t m_mesh_dimension;
+		GradientMode m_mode;
+		float m_coarse_tolerance;
+		// doubled so perm[perm[x] + y] never wraps, only filled in table mode
+		std::vector<int32_t> m_permutation;
 		std::vector<std::vector<glm::vec2>> m_corner_matrice;
 	};
 }
@@ -0,0 +1,103 @@
+#include "perlin_noise.h"
+#include <math.h>
+
+namespace evn_util {
+	namespace {
+		// the 12 cube edge directions, the first four repeated so a 4 bit
+		// hash picks one without a modulo
+		const float GRADIENTS_3D[16][3]{
+			{ 1, 1, 0 }, { -1, 1, 0 }, { 1, -1, 0 }, { -1, -1, 0 },
+			{ 1, 0, 1 }, { -1, 0, 1 }, { 1, 0, -1 }, { -1, 0, -1 },
+			{ 0, 1, 1 }, { 0, -1, 1 }, { 0, 1, -1 }, { 0, -1, -1 },
+			{ 1, 1, 0 }, { -1, 1, 0 }, { 0, -1, 1 }, { 0, -1, -1 }
+		};
+
+		inline uint32_t rotate(uint32_t v) { return v << 16 | v >> 16; }
+	}
+
+	int PerlinNoise::gradient3(int ix, int iy, int iz) const
+	{
+		if (m_mode == GradientMode::Table)
+			return m_permutation[m_permutation[m_permutation[ix & 255] + (iy & 255)] + (iz & 255)] & 15;
+
+		// the 2d hash with the third coordinate mixed in
+		uint32_t a = (uint32_t)ix, b = (uint32_t)iy, c = (uint32_t)iz;
+		a *= 3284157443u;
+		b ^= rotate(a);
+		b *= 1911520717u;
+		c ^= rotate(b);
+		c *= 2048419325u;
+		a ^= rotate(c);
+		a *= 3284157443u;
+		return (int)(a >> 28);
+	}
+
+	float PerlinNoise::dotGradient3(int ix, int iy, int iz, float dx, float dy, float dz) const
+	{
+		const float* g{ GRADIENTS_3D[gradient3(ix, iy, iz)] };
+		return dx * g[0] + dy * g[1] + dz * g[2];
+	}
+
+	float PerlinNoise::perlin3(float x, float y, float z)
+	{
+		float fx{ floorf(x) };
+		float fy{ floorf(y) };
+		float fz{ floorf(z) };
+		int x0{ (int)fx };
+		int y0{ (int)fy };
+		int z0{ (int)fz };
+		float dx{ x - fx };
+		float dy{ y - fy };
+		float dz{ z - fz };
+
+		// front face, z0
+		float d0{ dotGradient3(x0, y0, z0, dx, dy, dz) };
+		float d1{ dotGradient3(x0 + 1, y0, z0, dx - 1, dy, dz) };
+		float d2{ dotGradient3(x0, y0 + 1, z0, dx, dy - 1, dz) };
+		float d3{ dotGradient3(x0 + 1, y0 + 1, z0, dx - 1, dy - 1, dz) };
+		// back face, z0 + 1
+		float d4{ dotGradient3(x0, y0, z0 + 1, dx, dy, dz - 1) };
+		float d5{ dotGradient3(x0 + 1, y0, z0 + 1, dx - 1, dy, dz - 1) };
+		float d6{ dotGradient3(x0, y0 + 1, z0 + 1, dx, dy - 1, dz - 1) };
+		float d7{ dotGradient3(x0 + 1, y0 + 1, z0 + 1, dx - 1, dy - 1, dz - 1) };
+
+		float wx{ poly(dx) };
+		float wy{ poly(dy) };
+		float front{ linear(linear(d0, d1, wx), linear(d2, d3, wx), wy) };
+		float back{ linear(linear(d4, d5, wx), linear(d6, d7, wx), wy) };
+		return linear(front, back, poly(dz));
+	}
+
+	float PerlinNoise::octavePerlin3(float x, float y, float z, int octaves, float persistence)
+	{
+		float val{ 0.0f };
+		float freq{ 1 };
+		float amp{ 1 };
+
+		for (int i = 0; i < octaves; i++) {
+			val += perlin3(x * freq / m_dimensions, y * freq / m_dimensions, z * freq / m_dimensions) * amp;
+			freq *= 2;
+			amp *= persistence;
+		}
+
+		return val;
+	}
+
+	void PerlinNoise::octavePerlin3Batch(const float* x, const float* y, const float* z, float* out,
+		size_t count, int octaves, float persistence)
+	{
+		for (size_t i{ 0 }; i < count; i++)
+			out[i] = 0.0f;
+
+		// octave at a time so the gradient table and the output stay hot
+		float freq{ 1 };
+		float amp{ 1 };
+		for (int o{ 0 }; o < octaves; o++) {
+			float scale{ freq / m_dimensions };
+			for (size_t i{ 0 }; i < count; i++)
+				out[i] += perlin3(x[i] * scale, y[i] * scale, z[i] * scale) * amp;
+			freq *= 2;
+			amp *= persistence;
+		}
+	}
+}
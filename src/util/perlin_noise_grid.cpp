@@ -0,0 +1,508 @@
+#include "perlin_noise.h"
+#include "scratch_arena.h"
+#include <math.h>
+#include <algorithm>
+
+namespace evn_util {
+	namespace {
+		// largest |perlin()|, sqrt(0.5) with unit gradients and a little
+		// room for rounding
+		const float AMPLITUDE{ 0.7072f };
+		// octaves covering more lattice cells of a bounded box than this
+		// are bounded by their amplitude instead
+		const int MAX_BOUND_CELLS{ 16 };
+		// worst error of one octave of amplitude 1 upsampled from a sub-grid,
+		// per (stride / cell)^4 when the spans line up with the lattice
+		// cells and per (stride / cell)^2 when they cross them
+		const float SPAN_ERROR{ 0.5f };
+		const float KINK_ERROR{ 1.6f };
+
+		// closed range of values, for the bounds
+		struct Range {
+			float low;
+			float high;
+		};
+
+		// w * d for a weight range inside [0, 1]
+		inline Range weigh(Range w, Range d)
+		{
+			return { std::min(w.low * d.low, w.high * d.low), std::max(w.low * d.high, w.high * d.high) };
+		}
+
+		inline Range plus(Range a, Range b) { return { a.low + b.low, a.high + b.high }; }
+
+		// g . (p - corner) for p in [x0, x1] x [y0, y1], already relative to
+		// the corner
+		inline Range dotRange(const glm::vec2& g, float x0, float x1, float y0, float y1)
+		{
+			return {
+				std::min(g.x * x0, g.x * x1) + std::min(g.y * y0, g.y * y1),
+				std::max(g.x * x0, g.x * x1) + std::max(g.y * y0, g.y * y1)
+			};
+		}
+
+		// per octave values for one axis of the grid. d0/d1 are the distances
+		// to the lower and upper lattice line, w is the fade weight, dw its
+		// derivative and corner the lattice line below each sample
+		struct GridAxis {
+			ScratchArray<float> d0;
+			ScratchArray<float> d1;
+			ScratchArray<float> w;
+			ScratchArray<float> dw;
+			ScratchArray<int> corner;
+
+			// room for count samples, reused by every octave
+			void allocate(ScratchArena& arena, int count, bool derivatives)
+			{
+				d0 = arena.allocate<float>(count);
+				d1 = arena.allocate<float>(count);
+				w = arena.allocate<float>(count);
+				dw = arena.allocate<float>(derivatives ? count : 0);
+				corner = arena.allocate<int>(count);
+			}
+
+			void build(const float* coords, int count, float freq, float dim, bool derivatives)
+			{
+				for (int i{ 0 }; i < count; i++) {
+					float c{ coords[i] * freq / dim };
+					int c0{ (int)c };
+					corner[i] = c0;
+					d0[i] = c - (float)c0;
+					d1[i] = c - (float)(c0 + 1);
+					w[i] = PerlinNoise::poly(d0[i]);
+				}
+				if (!derivatives) return;
+				for (int i{ 0 }; i < count; i++)
+					dw[i] = PerlinNoise::polyDerivative(d0[i]);
+			}
+		};
+
+		// index of the first sample that sits on a multiple of stride steps.
+		// sub-grids start there, so grids sampling the same lattice put their
+		// sub-grid points in the same places and agree where they overlap.
+		// 0 when no sample does
+		inline int subGridPhase(const float* coords, int count, int stride)
+		{
+			float span{ fabsf(coords[1] - coords[0]) * stride };
+			for (int i{ 0 }; i < std::min(stride, count); i++) {
+				float k{ coords[i] / span };
+				if (fabsf(k - roundf(k)) < 1e-3f) return i;
+			}
+			return 0;
+		}
+
+		// gradients of one lattice row at every lattice column the grid uses
+		struct GradientRow {
+			int lattice_y{ 0 };
+			bool valid{ false };
+			ScratchArray<glm::vec2> gradients;
+		};
+	}
+
+	void PerlinNoise::octavePerlinGrid(const float* xs, int width, const float* ys, int height,
+		float* out, int octaves, float persistence, float cutoff)
+	{
+		octavePerlinGridDerivatives(xs, width, ys, height, out, nullptr, nullptr, octaves, persistence,
+			cutoff);
+	}
+
+	void PerlinNoise::octavePerlinGridDerivatives(const float* xs, int width, const float* ys, int height,
+		float* out, float* out_dx, float* out_dy, int octaves, float persistence, float cutoff)
+	{
+		ScratchArena& arena{ ScratchArena::local() };
+		ScratchArena::Scope scope{ arena };
+		ScratchArray<float> freq{ arena.allocate<float>(octaves) };
+		ScratchArray<float> amp{ arena.allocate<float>(octaves) };
+		float f{ 1 };
+		float a{ 1 };
+		for (int o{ 0 }; o < octaves; o++) {
+			freq[o] = f;
+			amp[o] = a;
+			f *= 2;
+			a *= persistence;
+		}
+		gridOctaves(xs, width, ys, height, out, out_dx, out_dy, freq.data(), amp.data(), octaves,
+			(float)m_dimensions, cutoff);
+	}
+
+	float PerlinNoise::amplitude() const
+	{
+		return AMPLITUDE;
+	}
+
+	void PerlinNoise::octaveNoiseBounds(float x0, float x1, float y0, float y1, int octaves,
+		float persistence, float& low, float& high)
+	{
+		low = 0.0f;
+		high = 0.0f;
+		float freq{ 1 };
+		float amp{ 1 };
+		for (int o{ 0 }; o < octaves; o++) {
+			float scale{ freq / m_dimensions };
+			float ax{ x0 * scale }, bx{ x1 * scale };
+			float ay{ y0 * scale }, by{ y1 * scale };
+			int cx0{ (int)ax }, cx1{ (int)bx };
+			int cy0{ (int)ay }, cy1{ (int)by };
+			Range octave{ -AMPLITUDE, AMPLITUDE };
+
+			// the fade weights only stay in [0, 1] for positive coordinates
+			if (ax >= 0.0f && ay >= 0.0f && (cx1 - cx0 + 1) * (cy1 - cy0 + 1) <= MAX_BOUND_CELLS) {
+				octave = { AMPLITUDE, -AMPLITUDE };
+				for (int cy{ cy0 }; cy <= cy1; cy++) {
+					for (int cx{ cx0 }; cx <= cx1; cx++) {
+						// the part of the box inside this cell, relative to it
+						float sx0{ std::max(ax - cx, 0.0f) }, sx1{ std::min(bx - cx, 1.0f) };
+						float sy0{ std::max(ay - cy, 0.0f) }, sy1{ std::min(by - cy, 1.0f) };
+						Range wx{ poly(sx0), poly(sx1) };
+						Range wy{ poly(sy0), poly(sy1) };
+						Range d0{ dotRange(randomGradient(cx, cy), sx0, sx1, sy0, sy1) };
+						Range d1{ dotRange(randomGradient(cx + 1, cy), sx0 - 1, sx1 - 1, sy0, sy1) };
+						Range d2{ dotRange(randomGradient(cx, cy + 1), sx0, sx1, sy0 - 1, sy1 - 1) };
+						Range d3{ dotRange(randomGradient(cx + 1, cy + 1), sx0 - 1, sx1 - 1, sy0 - 1, sy1 - 1) };
+						// both lerps as a weighted sum, the weights can't go negative
+						Range inv_wx{ 1.0f - wx.high, 1.0f - wx.low };
+						Range inv_wy{ 1.0f - wy.high, 1.0f - wy.low };
+						Range u{ plus(weigh(inv_wx, d0), weigh(wx, d1)) };
+						Range v{ plus(weigh(inv_wx, d2), weigh(wx, d3)) };
+						Range cell{ plus(weigh(inv_wy, u), weigh(wy, v)) };
+						octave.low = std::min(octave.low, cell.low);
+						octave.high = std::max(octave.high, cell.high);
+					}
+				}
+				octave.low = std::max(octave.low, -AMPLITUDE);
+				octave.high = std::min(octave.high, AMPLITUDE);
+			}
+
+			low += amp >= 0.0f ? octave.low * amp : octave.high * amp;
+			high += amp >= 0.0f ? octave.high * amp : octave.low * amp;
+			freq *= 2;
+			amp *= persistence;
+		}
+		// the batch kernels' gradients are off in the last bits
+		low -= 1e-4f;
+		high += 1e-4f;
+	}
+
+	int PerlinNoise::coarseOctaves(const float* xs, int width, const float* ys, int height,
+		const float* freq, const float* amp, int octaves, float dim, int& stride) const
+	{
+		stride = 1;
+		if (m_coarse_tolerance <= 0.0f || width < 2 || height < 2) return 0;
+
+		// the splines run over sample indices, so the samples must be evenly
+		// spaced for them to follow the noise
+		auto spacing = [](const float* coords, int count) {
+			float step{ coords[1] - coords[0] };
+			for (int i{ 2 }; i < count; i++)
+				if (fabsf(coords[i] - coords[i - 1] - step) > fabsf(step) * 1e-3f) return 0.0f;
+			return fabsf(step);
+		};
+		float step{ std::max(spacing(xs, width), spacing(ys, height)) };
+		if (step == 0.0f) return 0;
+
+		// pick the split that saves the most per sample work. spans that
+		// stay inside a lattice cell follow the noise's piecewise smooth
+		// shape and the error falls with (stride / cell)^4, spans crossing
+		// a cell border pick up the fade curve's kink and only fall with
+		// the square
+		auto aligned = [](float origin, float span) {
+			float cells{ 1.0f / span };
+			float first{ origin / span };
+			return fabsf(cells - roundf(cells)) < 1e-3f && fabsf(first - roundf(first)) < 1e-3f;
+		};
+		int best{ 0 };
+		float best_saving{ 0.0f };
+		for (int s : { 2, 4, 8 }) {
+			if (width < 2 * s || height < 2 * s) break;
+			float error{ 0.0f };
+			float origin_x{ xs[subGridPhase(xs, width, s)] };
+			float origin_y{ ys[subGridPhase(ys, height, s)] };
+			for (int o{ 0 }; o < octaves - 1; o++) {
+				float ratio{ s * step * freq[o] / dim };
+				bool smooth{ aligned(origin_x * freq[o] / dim, ratio) && aligned(origin_y * freq[o] / dim, ratio) };
+				error += fabsf(amp[o]) * (smooth ? SPAN_ERROR * ratio * ratio * ratio * ratio
+					: KINK_ERROR * ratio * ratio);
+				if (error > m_coarse_tolerance) break;
+				float saving{ (o + 1) * (1.0f - 1.0f / (s * s)) };
+				if (saving > best_saving) {
+					best = o + 1;
+					best_saving = saving;
+					stride = s;
+				}
+			}
+		}
+		return best;
+	}
+
+	void PerlinNoise::gridOctaves(const float* xs, int width, const float* ys, int height, float* out,
+		float* out_dx, float* out_dy, const float* freq, const float* amp, int octaves, float dim,
+		float cutoff)
+	{
+		size_t samples{ (size_t)width * height };
+		bool derivatives{ out_dx != nullptr && out_dy != nullptr };
+		// the low octaves are cheap next to the fine ones on values alone,
+		// their lattice corners and fades are shared by many samples. only
+		// the slopes cost enough per octave to be worth the sub-grid
+		int stride{ 1 };
+		int coarse{ derivatives ? coarseOctaves(xs, width, ys, height, freq, amp, octaves, dim, stride) : 0 };
+		if (coarse == 0) {
+			std::fill(out, out + samples, 0.0f);
+			if (derivatives) {
+				std::fill(out_dx, out_dx + samples, 0.0f);
+				std::fill(out_dy, out_dy + samples, 0.0f);
+			}
+			sumOctaves(xs, width, ys, height, out, out_dx, out_dy, freq, amp, 0, octaves, dim, cutoff);
+			return;
+		}
+
+		// sub-grid every stride samples from the phase sample on, with one
+		// extra point before the first sample and two after the last, the
+		// spline's footprint. shift is how far the first sample is into its
+		// span. the extra points continue the spacing, folded like the
+		// terrain folds negative coordinates
+		int shift_x{ (stride - subGridPhase(xs, width, stride)) % stride };
+		int shift_y{ (stride - subGridPhase(ys, height, stride)) % stride };
+		int coarse_width{ (width - 1 + shift_x) / stride + 4 };
+		int coarse_height{ (height - 1 + shift_y) / stride + 4 };
+		// every buffer below comes out of the thread's scratch arena, so a
+		// chunk the size of the last one doesn't touch the heap
+		ScratchArena& arena{ ScratchArena::local() };
+		ScratchArena::Scope scope{ arena };
+		auto subGrid = [&](const float* coords, int count, int shift, int coarse_count, ScratchArray<float>& grid) {
+			float step{ (coords[count - 1] - coords[0]) / (float)(count - 1) };
+			grid = arena.allocate<float>(coarse_count);
+			for (int j{ 0 }; j < coarse_count; j++) {
+				int i{ (j - 1) * stride - shift };
+				// points on the grid reuse its coordinates so they match exactly
+				grid[j] = (i >= 0 && i < count) ? coords[i] : fabsf(coords[0] + (float)i * step);
+			}
+			// the input distance covered by one span
+			return step * stride;
+		};
+		ScratchArray<float> coarse_x;
+		ScratchArray<float> coarse_y;
+		float span_x{ subGrid(xs, width, shift_x, coarse_width, coarse_x) };
+		float span_y{ subGrid(ys, height, shift_y, coarse_height, coarse_y) };
+
+		// the slopes are always needed, they shape the splines
+		size_t coarse_samples{ (size_t)coarse_width * coarse_height };
+		ScratchArray<float> low{ arena.allocate<float>(coarse_samples, 0.0f) };
+		ScratchArray<float> low_dx{ arena.allocate<float>(coarse_samples, 0.0f) };
+		ScratchArray<float> low_dy{ arena.allocate<float>(coarse_samples, 0.0f) };
+		sumOctaves(coarse_x.data(), coarse_width, coarse_y.data(), coarse_height, low.data(),
+			low_dx.data(), low_dy.data(), freq, amp, 0, coarse, dim, NO_CUTOFF);
+
+		// weights for each offset t inside a span. values use cubic hermite
+		// splines through the sub-grid values and slopes, which stay inside
+		// one lattice cell when the stride divides it, so the fade curve's
+		// kinks at the cell borders never land inside a span. the slope
+		// across the spline's axis has no slope of its own to use and gets
+		// a catmull-rom spline over four points instead. at t = 0 every
+		// spline returns the sub-grid value as is, so chunk borders match
+		struct SpanWeights {
+			float hermite[4];
+			float slope[4];
+			float catmull_rom[4];
+		};
+		ScratchArray<SpanWeights> weights{ arena.allocate<SpanWeights>(stride) };
+		for (int t{ 0 }; t < stride; t++) {
+			float f{ (float)t / stride };
+			float f2{ f * f };
+			float f3{ f2 * f };
+			SpanWeights& w{ weights[t] };
+			// start value, start slope, end value, end slope
+			w.hermite[0] = 2.0f * f3 - 3.0f * f2 + 1.0f;
+			w.hermite[1] = f3 - 2.0f * f2 + f;
+			w.hermite[2] = 3.0f * f2 - 2.0f * f3;
+			w.hermite[3] = f3 - f2;
+			// the same spline differentiated by f
+			w.slope[0] = 6.0f * f2 - 6.0f * f;
+			w.slope[1] = 3.0f * f2 - 4.0f * f + 1.0f;
+			w.slope[2] = 6.0f * f - 6.0f * f2;
+			w.slope[3] = 3.0f * f2 - 2.0f * f;
+			w.catmull_rom[0] = 0.5f * (-f3 + 2.0f * f2 - f);
+			w.catmull_rom[1] = 0.5f * (3.0f * f3 - 5.0f * f2 + 2.0f);
+			w.catmull_rom[2] = 0.5f * (-3.0f * f3 + 4.0f * f2 + f);
+			w.catmull_rom[3] = 0.5f * (f3 - f2);
+		}
+		auto hermite = [](const float* w, float v0, float s0, float v1, float s1) {
+			return w[0] * v0 + w[1] * s0 + w[2] * v1 + w[3] * s1;
+		};
+		auto catmullRom = [](const float* w, float p0, float p1, float p2, float p3) {
+			return w[0] * p0 + w[1] * p1 + w[2] * p2 + w[3] * p3;
+		};
+
+		// along x on every sub-grid row, the value and its slope along y.
+		// slopes are per unit of input, a span covers span_x of it
+		size_t row_samples{ (size_t)coarse_height * width };
+		ScratchArray<float> row_value{ arena.allocate<float>(row_samples) };
+		ScratchArray<float> row_dy{ arena.allocate<float>(row_samples) };
+		ScratchArray<float> row_dx{ arena.allocate<float>(derivatives ? row_samples : 0) };
+		for (int j{ 0 }; j < coarse_height; j++) {
+			const float* value{ low.data() + (size_t)j * coarse_width };
+			const float* dx{ low_dx.data() + (size_t)j * coarse_width };
+			const float* dy{ low_dy.data() + (size_t)j * coarse_width };
+			size_t row{ (size_t)j * width };
+			for (int x{ 0 }; x < width; x++) {
+				const SpanWeights& w{ weights[(x + shift_x) % stride] };
+				int i{ (x + shift_x) / stride + 1 };
+				row_value[row + x] = hermite(w.hermite, value[i], dx[i] * span_x, value[i + 1], dx[i + 1] * span_x);
+				row_dy[row + x] = catmullRom(w.catmull_rom, dy[i - 1], dy[i], dy[i + 1], dy[i + 2]);
+				if (derivatives)
+					row_dx[row + x] = hermite(w.slope, value[i], dx[i] * span_x, value[i + 1], dx[i + 1] * span_x) / span_x;
+			}
+		}
+
+		// then along y for every sample
+		for (int y{ 0 }; y < height; y++) {
+			const SpanWeights& w{ weights[(y + shift_y) % stride] };
+			size_t r0{ (size_t)((y + shift_y) / stride) * width };
+			size_t r1{ r0 + width };
+			size_t r2{ r1 + width };
+			size_t r3{ r2 + width };
+			float* row_out{ out + (size_t)y * width };
+			for (int x{ 0 }; x < width; x++)
+				row_out[x] = hermite(w.hermite, row_value[r1 + x], row_dy[r1 + x] * span_y,
+					row_value[r2 + x], row_dy[r2 + x] * span_y);
+			if (!derivatives) continue;
+			float* out_row_dx{ out_dx + (size_t)y * width };
+			float* out_row_dy{ out_dy + (size_t)y * width };
+			for (int x{ 0 }; x < width; x++) {
+				out_row_dx[x] = catmullRom(w.catmull_rom, row_dx[r0 + x], row_dx[r1 + x], row_dx[r2 + x], row_dx[r3 + x]);
+				out_row_dy[x] = hermite(w.slope, row_value[r1 + x], row_dy[r1 + x] * span_y,
+					row_value[r2 + x], row_dy[r2 + x] * span_y) / span_y;
+			}
+		}
+
+		sumOctaves(xs, width, ys, height, out, out_dx, out_dy, freq, amp, coarse, octaves, dim, cutoff);
+	}
+
+	void PerlinNoise::sumOctaves(const float* xs, int width, const float* ys, int height, float* out,
+		float* out_dx, float* out_dy, const float* freq, const float* amp, int first, int octaves,
+		float dim, float cutoff)
+	{
+		bool derivatives{ out_dx != nullptr && out_dy != nullptr };
+		bool early_out{ cutoff != NO_CUTOFF };
+		ScratchArena& arena{ ScratchArena::local() };
+		ScratchArena::Scope scope{ arena };
+		// rest[o] is the most octaves o.. can still add, with a little
+		// slack so rounding in the sum can't cross the cutoff
+		ScratchArray<float> rest{ arena.allocate<float>(octaves + 1, 0.0f) };
+		for (int o{ octaves - 1 }; o >= first; o--)
+			rest[o] = rest[o + 1] + fabsf(amp[o]) * AMPLITUDE * 1.0001f;
+
+		GridAxis columns;
+		GridAxis rows;
+		columns.allocate(arena, width, derivatives);
+		rows.allocate(arena, height, derivatives);
+		// every sample adds at most two lattice columns
+		ScratchArray<int> lattice{ arena.allocate<int>((size_t)width * 2) };
+		ScratchArray<int> lower{ arena.allocate<int>(width) };
+		ScratchArray<int> upper{ arena.allocate<int>(width) };
+		GradientRow cache[2];
+		cache[0].gradients = arena.allocate<glm::vec2>(lattice.size());
+		cache[1].gradients = arena.allocate<glm::vec2>(lattice.size());
+
+		for (int o{ first }; o < octaves; o++) {
+			columns.build(xs, width, freq[o], dim, derivatives);
+			rows.build(ys, height, freq[o], dim, derivatives);
+			// the lattice coordinate moves freq / dim per unit of input
+			float slope{ amp[o] * freq[o] / dim };
+
+			// distinct lattice columns touched by this octave, each sample
+			// keeps the index of its two corners in that list
+			for (int x{ 0 }; x < width; x++) {
+				lattice[2 * x] = columns.corner[x];
+				lattice[2 * x + 1] = columns.corner[x] + 1;
+			}
+			std::sort(lattice.begin(), lattice.end());
+			int* lattice_end{ std::unique(lattice.begin(), lattice.end()) };
+			size_t lattice_count{ (size_t)(lattice_end - lattice.begin()) };
+			for (int x{ 0 }; x < width; x++) {
+				lower[x] = (int)(std::lower_bound(lattice.begin(), lattice_end, columns.corner[x]) - lattice.begin());
+				upper[x] = (int)(std::lower_bound(lattice.begin(), lattice_end, columns.corner[x] + 1) - lattice.begin());
+			}
+
+			cache[0].valid = cache[1].valid = false;
+			// fetches the gradients of a lattice row, never evicting the row
+			// given in keep since the sample row needs both of its corners
+			auto gradientRow = [&](int lattice_y, int keep) -> const glm::vec2* {
+				for (auto& row : cache)
+					if (row.valid && row.lattice_y == lattice_y) return row.gradients.data();
+				GradientRow& row{ (cache[0].valid && cache[0].lattice_y == keep) ? cache[1] : cache[0] };
+				row.lattice_y = lattice_y;
+				row.valid = true;
+				for (size_t i{ 0 }; i < lattice_count; i++)
+					row.gradients[i] = randomGradient(lattice[i], lattice_y);
+				return row.gradients.data();
+			};
+
+			for (int y{ 0 }; y < height; y++) {
+				float* row_out{ out + (size_t)y * width };
+				// a sample is done once the octaves left can't bring it back
+				// to the cutoff, rows with nothing left skip their gradients
+				auto done = [&](float value) { return value + rest[o] < cutoff; };
+				if (early_out && std::all_of(row_out, row_out + width, done))
+					continue;
+
+				const glm::vec2* top{ gradientRow(rows.corner[y], rows.corner[y] + 1) };
+				const glm::vec2* bottom{ gradientRow(rows.corner[y] + 1, rows.corner[y]) };
+				float dy0{ rows.d0[y] };
+				float dy1{ rows.d1[y] };
+				float wy{ rows.w[y] };
+
+				if (derivatives) {
+					float dwy{ rows.dw[y] };
+					float* row_dx{ out_dx + (size_t)y * width };
+					float* row_dy{ out_dy + (size_t)y * width };
+					for (int x{ 0 }; x < width; x++) {
+						if (early_out && done(row_out[x])) continue;
+						const glm::vec2& g0{ top[lower[x]] };
+						const glm::vec2& g1{ top[upper[x]] };
+						const glm::vec2& g2{ bottom[lower[x]] };
+						const glm::vec2& g3{ bottom[upper[x]] };
+						float dx0{ columns.d0[x] };
+						float dx1{ columns.d1[x] };
+						float wx{ columns.w[x] };
+						float dwx{ columns.dw[x] };
+
+						float d0{ dx0 * g0.x + dy0 * g0.y };
+						float d1{ dx1 * g1.x + dy0 * g1.y };
+						float d2{ dx0 * g2.x + dy1 * g2.y };
+						float d3{ dx1 * g3.x + dy1 * g3.y };
+						float u{ linear(d0, d1, wx) };
+						float v{ linear(d2, d3, wx) };
+						row_out[x] += linear(u, v, wy) * amp[o];
+
+						// product rule through both lerps
+						float ux{ linear(g0.x, g1.x, wx) + dwx * (d1 - d0) };
+						float vx{ linear(g2.x, g3.x, wx) + dwx * (d3 - d2) };
+						float uy{ linear(g0.y, g1.y, wx) };
+						float vy{ linear(g2.y, g3.y, wx) };
+						row_dx[x] += linear(ux, vx, wy) * slope;
+						row_dy[x] += (linear(uy, vy, wy) + dwy * (v - u)) * slope;
+					}
+					continue;
+				}
+
+				for (int x{ 0 }; x < width; x++) {
+					if (early_out && done(row_out[x])) continue;
+					const glm::vec2& g0{ top[lower[x]] };
+					const glm::vec2& g1{ top[upper[x]] };
+					const glm::vec2& g2{ bottom[lower[x]] };
+					const glm::vec2& g3{ bottom[upper[x]] };
+					float dx0{ columns.d0[x] };
+					float dx1{ columns.d1[x] };
+
+					float d0{ dx0 * g0.x + dy0 * g0.y };
+					float d1{ dx1 * g1.x + dy0 * g1.y };
+					float d2{ dx0 * g2.x + dy1 * g2.y };
+					float d3{ dx1 * g3.x + dy1 * g3.y };
+					float u{ linear(d0, d1, columns.w[x]) };
+					float v{ linear(d2, d3, columns.w[x]) };
+					row_out[x] += linear(u, v, wy) * amp[o];
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,390 @@
+#include "perlin_noise_simd.h"
+#include "perlin_noise.h"
+#include <atomic>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define EVN_SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// gcc and clang need the instruction set enabled per function, msvc lets
+// any function use the intrinsics
+#if defined(__GNUC__) || defined(__clang__)
+#define EVN_TARGET(x) __attribute__((target(x)))
+#else
+#define EVN_TARGET(x)
+#endif
+
+namespace evn_util {
+	namespace simd {
+		static std::atomic<int> s_level{ -1 };
+
+		static inline void gradient(const GradientTable* table, int ix, int iy, float& gx, float& gy)
+		{
+			if (table) tableGradient(*table, ix, iy, gx, gy);
+			else hashGradient(ix, iy, gx, gy);
+		}
+
+		static inline float perlinSample(float x, float y, const GradientTable* table)
+		{
+			int x0{ (int)x };
+			int y0{ (int)y };
+			int x1{ x0 + 1 };
+			int y1{ y0 + 1 };
+			float fx0{ (float)x0 }, fx1{ (float)x1 };
+			float fy0{ (float)y0 }, fy1{ (float)y1 };
+
+			float gx, gy;
+			gradient(table, x0, y0, gx, gy);
+			float d0{ (x - fx0) * gx + (y - fy0) * gy };
+			gradient(table, x1, y0, gx, gy);
+			float d1{ (x - fx1) * gx + (y - fy0) * gy };
+			gradient(table, x0, y1, gx, gy);
+			float d2{ (x - fx0) * gx + (y - fy1) * gy };
+			gradient(table, x1, y1, gx, gy);
+			float d3{ (x - fx1) * gx + (y - fy1) * gy };
+
+			float sx{ x - fx0 };
+			float sy{ y - fy0 };
+			float u{ PerlinNoise::interp(d0, d1, sx) };
+			float v{ PerlinNoise::interp(d2, d3, sx) };
+			return PerlinNoise::interp(u, v, sy);
+		}
+
+		static void octavePerlinScalar(const float* x, const float* y, float* out, size_t count,
+			int octaves, float persistence, float dim, const GradientTable* table)
+		{
+			for (size_t i{ 0 }; i < count; i++) {
+				float val{ 0.0f };
+				float freq{ 1 };
+				float amp{ 1 };
+				for (int o{ 0 }; o < octaves; o++) {
+					val += perlinSample(x[i] * freq / dim, y[i] * freq / dim, table) * amp;
+					freq *= 2;
+					amp *= persistence;
+				}
+				out[i] = val;
+			}
+		}
+
+#ifdef EVN_SIMD_X86
+		// ---- SSE 4.1, 4 lanes ----
+
+		EVN_TARGET("sse4.1")
+		static inline __m128 gradientDotSSE41(__m128i ix, __m128i iy, __m128 dx, __m128 dy)
+		{
+			__m128i a{ _mm_mullo_epi32(ix, _mm_set1_epi32((int)3284157443u)) };
+			__m128i b{ _mm_xor_si128(iy, _mm_or_si128(_mm_slli_epi32(a, 16), _mm_srli_epi32(a, 16))) };
+			b = _mm_mullo_epi32(b, _mm_set1_epi32((int)1911520717u));
+			a = _mm_xor_si128(a, _mm_or_si128(_mm_slli_epi32(b, 16), _mm_srli_epi32(b, 16)));
+			a = _mm_mullo_epi32(a, _mm_set1_epi32((int)2048419325u));
+
+			__m128i q{ _mm_srli_epi32(_mm_add_epi32(a, _mm_set1_epi32(1 << 29)), 30) };
+			__m128i d{ _mm_sub_epi32(a, _mm_slli_epi32(q, 30)) };
+			__m128 r{ _mm_mul_ps(_mm_cvtepi32_ps(d), _mm_set1_ps(1.46291807926715968e-9f)) };
+			__m128 r2{ _mm_mul_ps(r, r) };
+
+			__m128 s{ _mm_mul_ps(r2, _mm_set1_ps(-1.98412698e-4f)) };
+			s = _mm_mul_ps(r2, _mm_add_ps(_mm_set1_ps(8.33333333e-3f), s));
+			s = _mm_add_ps(_mm_set1_ps(-1.66666667e-1f), s);
+			s = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(r, r2), s));
+
+			__m128 c{ _mm_mul_ps(r2, _mm_set1_ps(2.48015873e-5f)) };
+			c = _mm_mul_ps(r2, _mm_add_ps(_mm_set1_ps(-1.38888889e-3f), c));
+			c = _mm_mul_ps(r2, _mm_add_ps(_mm_set1_ps(4.16666667e-2f), c));
+			c = _mm_mul_ps(r2, _mm_add_ps(_mm_set1_ps(-0.5f), c));
+			c = _mm_add_ps(_mm_set1_ps(1.0f), c);
+
+			__m128i one{ _mm_set1_epi32(1) };
+			__m128 odd{ _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(q, one), one)) };
+			__m128 sx{ _mm_blendv_ps(s, c, odd) };
+			__m128 cx{ _mm_blendv_ps(c, s, odd) };
+			__m128i sin_sign{ _mm_slli_epi32(_mm_and_si128(q, _mm_set1_epi32(2)), 30) };
+			__m128i cos_sign{ _mm_slli_epi32(_mm_and_si128(_mm_xor_si128(q, _mm_srli_epi32(q, 1)), one), 31) };
+			__m128 gx{ _mm_xor_ps(sx, _mm_castsi128_ps(sin_sign)) };
+			__m128 gy{ _mm_xor_ps(cx, _mm_castsi128_ps(cos_sign)) };
+
+			return _mm_add_ps(_mm_mul_ps(dx, gx), _mm_mul_ps(dy, gy));
+		}
+
+		EVN_TARGET("sse4.1")
+		static inline __m128 tableDotSSE41(const GradientTable& table, __m128i ix, __m128i iy, __m128 dx, __m128 dy)
+		{
+			// no gather before avx2, do the lookups one lane at a time
+			alignas(16) int32_t lanes_x[4];
+			alignas(16) int32_t lanes_y[4];
+			alignas(16) float gx[4];
+			alignas(16) float gy[4];
+			_mm_store_si128((__m128i*)lanes_x, ix);
+			_mm_store_si128((__m128i*)lanes_y, iy);
+			for (int i{ 0 }; i < 4; i++)
+				tableGradient(table, lanes_x[i], lanes_y[i], gx[i], gy[i]);
+			return _mm_add_ps(_mm_mul_ps(dx, _mm_load_ps(gx)), _mm_mul_ps(dy, _mm_load_ps(gy)));
+		}
+
+		EVN_TARGET("sse4.1")
+		static inline __m128 dotSSE41(const GradientTable* table, __m128i ix, __m128i iy, __m128 dx, __m128 dy)
+		{
+			if (table) return tableDotSSE41(*table, ix, iy, dx, dy);
+			return gradientDotSSE41(ix, iy, dx, dy);
+		}
+
+		EVN_TARGET("sse4.1")
+		static inline __m128 lerpSSE41(__m128 start, __m128 end, __m128 coef)
+		{
+			return _mm_add_ps(_mm_mul_ps(coef, _mm_sub_ps(end, start)), start);
+		}
+
+		EVN_TARGET("sse4.1")
+		static inline __m128 polySSE41(__m128 c)
+		{
+			__m128 a{ _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(3.0f), c), c) };
+			__m128 b{ _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(_mm_set1_ps(2.0f), c), c), c) };
+			return _mm_sub_ps(a, b);
+		}
+
+		EVN_TARGET("sse4.1")
+		static inline __m128 perlinSSE41(__m128 x, __m128 y, const GradientTable* table)
+		{
+			__m128i one{ _mm_set1_epi32(1) };
+			__m128i ix0{ _mm_cvttps_epi32(x) };
+			__m128i iy0{ _mm_cvttps_epi32(y) };
+			__m128i ix1{ _mm_add_epi32(ix0, one) };
+			__m128i iy1{ _mm_add_epi32(iy0, one) };
+			__m128 dx0{ _mm_sub_ps(x, _mm_cvtepi32_ps(ix0)) };
+			__m128 dx1{ _mm_sub_ps(x, _mm_cvtepi32_ps(ix1)) };
+			__m128 dy0{ _mm_sub_ps(y, _mm_cvtepi32_ps(iy0)) };
+			__m128 dy1{ _mm_sub_ps(y, _mm_cvtepi32_ps(iy1)) };
+
+			__m128 d0{ dotSSE41(table, ix0, iy0, dx0, dy0) };
+			__m128 d1{ dotSSE41(table, ix1, iy0, dx1, dy0) };
+			__m128 d2{ dotSSE41(table, ix0, iy1, dx0, dy1) };
+			__m128 d3{ dotSSE41(table, ix1, iy1, dx1, dy1) };
+
+			__m128 wx{ polySSE41(dx0) };
+			__m128 u{ lerpSSE41(d0, d1, wx) };
+			__m128 v{ lerpSSE41(d2, d3, wx) };
+			return lerpSSE41(u, v, polySSE41(dy0));
+		}
+
+		EVN_TARGET("sse4.1")
+		static void octavePerlinSSE41(const float* x, const float* y, float* out, size_t count,
+			int octaves, float persistence, float dim, const GradientTable* table)
+		{
+			__m128 vdim{ _mm_set1_ps(dim) };
+			size_t i{ 0 };
+			for (; i + 4 <= count; i += 4) {
+				__m128 px{ _mm_loadu_ps(x + i) };
+				__m128 py{ _mm_loadu_ps(y + i) };
+				__m128 val{ _mm_setzero_ps() };
+				float freq{ 1 };
+				float amp{ 1 };
+				for (int o{ 0 }; o < octaves; o++) {
+					__m128 vfreq{ _mm_set1_ps(freq) };
+					__m128 n{ perlinSSE41(_mm_div_ps(_mm_mul_ps(px, vfreq), vdim),
+						_mm_div_ps(_mm_mul_ps(py, vfreq), vdim), table) };
+					val = _mm_add_ps(val, _mm_mul_ps(n, _mm_set1_ps(amp)));
+					freq *= 2;
+					amp *= persistence;
+				}
+				_mm_storeu_ps(out + i, val);
+			}
+			octavePerlinScalar(x + i, y + i, out + i, count - i, octaves, persistence, dim, table);
+		}
+
+		// ---- AVX2, 8 lanes ----
+
+		EVN_TARGET("avx2")
+		static inline __m256 gradientDotAVX2(__m256i ix, __m256i iy, __m256 dx, __m256 dy)
+		{
+			__m256i a{ _mm256_mullo_epi32(ix, _mm256_set1_epi32((int)3284157443u)) };
+			__m256i b{ _mm256_xor_si256(iy, _mm256_or_si256(_mm256_slli_epi32(a, 16), _mm256_srli_epi32(a, 16))) };
+			b = _mm256_mullo_epi32(b, _mm256_set1_epi32((int)1911520717u));
+			a = _mm256_xor_si256(a, _mm256_or_si256(_mm256_slli_epi32(b, 16), _mm256_srli_epi32(b, 16)));
+			a = _mm256_mullo_epi32(a, _mm256_set1_epi32((int)2048419325u));
+
+			__m256i q{ _mm256_srli_epi32(_mm256_add_epi32(a, _mm256_set1_epi32(1 << 29)), 30) };
+			__m256i d{ _mm256_sub_epi32(a, _mm256_slli_epi32(q, 30)) };
+			__m256 r{ _mm256_mul_ps(_mm256_cvtepi32_ps(d), _mm256_set1_ps(1.46291807926715968e-9f)) };
+			__m256 r2{ _mm256_mul_ps(r, r) };
+
+			__m256 s{ _mm256_mul_ps(r2, _mm256_set1_ps(-1.98412698e-4f)) };
+			s = _mm256_mul_ps(r2, _mm256_add_ps(_mm256_set1_ps(8.33333333e-3f), s));
+			s = _mm256_add_ps(_mm256_set1_ps(-1.66666667e-1f), s);
+			s = _mm256_add_ps(r, _mm256_mul_ps(_mm256_mul_ps(r, r2), s));
+
+			__m256 c{ _mm256_mul_ps(r2, _mm256_set1_ps(2.48015873e-5f)) };
+			c = _mm256_mul_ps(r2, _mm256_add_ps(_mm256_set1_ps(-1.38888889e-3f), c));
+			c = _mm256_mul_ps(r2, _mm256_add_ps(_mm256_set1_ps(4.16666667e-2f), c));
+			c = _mm256_mul_ps(r2, _mm256_add_ps(_mm256_set1_ps(-0.5f), c));
+			c = _mm256_add_ps(_mm256_set1_ps(1.0f), c);
+
+			__m256i one{ _mm256_set1_epi32(1) };
+			__m256 odd{ _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(q, one), one)) };
+			__m256 sx{ _mm256_blendv_ps(s, c, odd) };
+			__m256 cx{ _mm256_blendv_ps(c, s, odd) };
+			__m256i sin_sign{ _mm256_slli_epi32(_mm256_and_si256(q, _mm256_set1_epi32(2)), 30) };
+			__m256i cos_sign{ _mm256_slli_epi32(_mm256_and_si256(_mm256_xor_si256(q, _mm256_srli_epi32(q, 1)), one), 31) };
+			__m256 gx{ _mm256_xor_ps(sx, _mm256_castsi256_ps(sin_sign)) };
+			__m256 gy{ _mm256_xor_ps(cx, _mm256_castsi256_ps(cos_sign)) };
+
+			return _mm256_add_ps(_mm256_mul_ps(dx, gx), _mm256_mul_ps(dy, gy));
+		}
+
+		EVN_TARGET("avx2")
+		static inline __m256 tableDotAVX2(const GradientTable& table, __m256i ix, __m256i iy, __m256 dx, __m256 dy)
+		{
+			__m256i mask{ _mm256_set1_epi32(255) };
+			__m256i h{ _mm256_i32gather_epi32((const int*)table.perm, _mm256_and_si256(ix, mask), 4) };
+			h = _mm256_i32gather_epi32((const int*)table.perm, _mm256_add_epi32(h, _mm256_and_si256(iy, mask)), 4);
+			h = _mm256_and_si256(h, _mm256_set1_epi32(15));
+			__m256 gx{ _mm256_i32gather_ps(table.gx, h, 4) };
+			__m256 gy{ _mm256_i32gather_ps(table.gy, h, 4) };
+			return _mm256_add_ps(_mm256_mul_ps(dx, gx), _mm256_mul_ps(dy, gy));
+		}
+
+		EVN_TARGET("avx2")
+		static inline __m256 dotAVX2(const GradientTable* table, __m256i ix, __m256i iy, __m256 dx, __m256 dy)
+		{
+			if (table) return tableDotAVX2(*table, ix, iy, dx, dy);
+			return gradientDotAVX2(ix, iy, dx, dy);
+		}
+
+		EVN_TARGET("avx2")
+		static inline __m256 lerpAVX2(__m256 start, __m256 end, __m256 coef)
+		{
+			return _mm256_add_ps(_mm256_mul_ps(coef, _mm256_sub_ps(end, start)), start);
+		}
+
+		EVN_TARGET("avx2")
+		static inline __m256 polyAVX2(__m256 c)
+		{
+			__m256 a{ _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(3.0f), c), c) };
+			__m256 b{ _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(2.0f), c), c), c) };
+			return _mm256_sub_ps(a, b);
+		}
+
+		EVN_TARGET("avx2")
+		static inline __m256 perlinAVX2(__m256 x, __m256 y, const GradientTable* table)
+		{
+			__m256i one{ _mm256_set1_epi32(1) };
+			__m256i ix0{ _mm256_cvttps_epi32(x) };
+			__m256i iy0{ _mm256_cvttps_epi32(y) };
+			__m256i ix1{ _mm256_add_epi32(ix0, one) };
+			__m256i iy1{ _mm256_add_epi32(iy0, one) };
+			__m256 dx0{ _mm256_sub_ps(x, _mm256_cvtepi32_ps(ix0)) };
+			__m256 dx1{ _mm256_sub_ps(x, _mm256_cvtepi32_ps(ix1)) };
+			__m256 dy0{ _mm256_sub_ps(y, _mm256_cvtepi32_ps(iy0)) };
+			__m256 dy1{ _mm256_sub_ps(y, _mm256_cvtepi32_ps(iy1)) };
+
+			__m256 d0{ dotAVX2(table, ix0, iy0, dx0, dy0) };
+			__m256 d1{ dotAVX2(table, ix1, iy0, dx1, dy0) };
+			__m256 d2{ dotAVX2(table, ix0, iy1, dx0, dy1) };
+			__m256 d3{ dotAVX2(table, ix1, iy1, dx1, dy1) };
+
+			__m256 wx{ polyAVX2(dx0) };
+			__m256 u{ lerpAVX2(d0, d1, wx) };
+			__m256 v{ lerpAVX2(d2, d3, wx) };
+			return lerpAVX2(u, v, polyAVX2(dy0));
+		}
+
+		EVN_TARGET("avx2")
+		static void octavePerlinAVX2(const float* x, const float* y, float* out, size_t count,
+			int octaves, float persistence, float dim, const GradientTable* table)
+		{
+			__m256 vdim{ _mm256_set1_ps(dim) };
+			size_t i{ 0 };
+			for (; i + 8 <= count; i += 8) {
+				__m256 px{ _mm256_loadu_ps(x + i) };
+				__m256 py{ _mm256_loadu_ps(y + i) };
+				__m256 val{ _mm256_setzero_ps() };
+				float freq{ 1 };
+				float amp{ 1 };
+				for (int o{ 0 }; o < octaves; o++) {
+					__m256 vfreq{ _mm256_set1_ps(freq) };
+					__m256 n{ perlinAVX2(_mm256_div_ps(_mm256_mul_ps(px, vfreq), vdim),
+						_mm256_div_ps(_mm256_mul_ps(py, vfreq), vdim), table) };
+					val = _mm256_add_ps(val, _mm256_mul_ps(n, _mm256_set1_ps(amp)));
+					freq *= 2;
+					amp *= persistence;
+				}
+				_mm256_storeu_ps(out + i, val);
+			}
+			octavePerlinScalar(x + i, y + i, out + i, count - i, octaves, persistence, dim, table);
+		}
+#endif // EVN_SIMD_X86
+
+		Level detect()
+		{
+#ifdef EVN_SIMD_X86
+#if defined(_MSC_VER)
+			int info[4];
+			__cpuid(info, 0);
+			int max_leaf{ info[0] };
+			__cpuid(info, 1);
+			bool sse41{ (info[2] & (1 << 19)) != 0 };
+			// avx needs the os to save the ymm registers as well
+			bool os_avx{ (info[2] & (1 << 27)) && (info[2] & (1 << 28)) &&
+				(_xgetbv(0) & 6) == 6 };
+			if (os_avx && max_leaf >= 7) {
+				__cpuidex(info, 7, 0);
+				if (info[1] & (1 << 5)) return Level::AVX2;
+			}
+			if (sse41) return Level::SSE41;
+#else
+			__builtin_cpu_init();
+			if (__builtin_cpu_supports("avx2")) return Level::AVX2;
+			if (__builtin_cpu_supports("sse4.1")) return Level::SSE41;
+#endif
+#endif
+			return Level::Scalar;
+		}
+
+		Level active()
+		{
+			int level{ s_level.load(std::memory_order_relaxed) };
+			if (level < 0) {
+				level = (int)detect();
+				s_level.store(level, std::memory_order_relaxed);
+			}
+			return (Level)level;
+		}
+
+		void setLevel(Level level)
+		{
+			Level supported{ detect() };
+			if ((int)level > (int)supported) level = supported;
+			s_level.store((int)level, std::memory_order_relaxed);
+		}
+
+		const char* levelName(Level level)
+		{
+			switch (level) {
+			case Level::AVX2: return "avx2";
+			case Level::SSE41: return "sse4.1";
+			default: return "scalar";
+			}
+		}
+
+		void octavePerlin(const float* x, const float* y, float* out, size_t count,
+			int octaves, float persistence, float dim, const GradientTable* table)
+		{
+			switch (active()) {
+#ifdef EVN_SIMD_X86
+			case Level::AVX2:
+				octavePerlinAVX2(x, y, out, count, octaves, persistence, dim, table);
+				break;
+			case Level::SSE41:
+				octavePerlinSSE41(x, y, out, count, octaves, persistence, dim, table);
+				break;
+#endif
+			default:
+				octavePerlinScalar(x, y, out, count, octaves, persistence, dim, table);
+				break;
+			}
+		}
+	}
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// internal batch kernels used by PerlinNoise. each instruction set gets its
+// own kernel and the best one the cpu supports is picked the first time a
+// batch is evaluated. every kernel does the same float operations in the same
+// order, so the scalar fallback returns bit identical results
+namespace evn_util {
+	namespace simd {
+		enum class Level {
+			Scalar,
+			SSE41,
+			AVX2
+		};
+
+		// highest level supported by this cpu
+		Level detect();
+		// level the batch functions currently dispatch to
+		Level active();
+		// force a lower level, used to compare kernels. requests above what
+		// the cpu supports are clamped to the detected level
+		void setLevel(Level level);
+		const char* levelName(Level level);
+
+		// seeded permutation table and the fixed set of unit gradients used
+		// by GradientMode::Table. perm holds 512 entries so the second
+		// lookup never needs to wrap
+		struct GradientTable {
+			const int32_t* perm;
+			const float* gx;
+			const float* gy;
+		};
+
+		// out[i] = sum over octaves of perlin(x[i] * freq / dim, y[i] * freq / dim) * amp
+		// table is null when the hashed gradients are used
+		void octavePerlin(const float* x, const float* y, float* out, size_t count,
+			int octaves, float persistence, float dim, const GradientTable* table);
+
+		// gradient used by the batch kernels. same hash as
+		// PerlinNoise::randomGradient but the angle is turned into a vector
+		// with a polynomial instead of libm so it can run across lanes
+		static inline void hashGradient(int ix, int iy, float& gx, float& gy)
+		{
+			uint32_t a = (uint32_t)ix, b = (uint32_t)iy;
+			a *= 3284157443u;
+			b ^= a << 16 | a >> 16;
+			b *= 1911520717u;
+			a ^= b << 16 | b >> 16;
+			a *= 2048419325u;
+
+			// the hash is the angle in units of 2*Pi / 2^32. split it into a
+			// quadrant and a remainder in [-Pi/4, Pi/4)
+			uint32_t q = (a + (1u << 29)) >> 30;
+			int32_t d = (int32_t)(a - (q << 30));
+			float r = (float)d * 1.46291807926715968e-9f; // (Pi / 2) / 2^30
+			float r2 = r * r;
+			float s = r + r * r2 * (-1.66666667e-1f + r2 * (8.33333333e-3f + r2 * -1.98412698e-4f));
+			float c = 1.0f + r2 * (-0.5f + r2 * (4.16666667e-2f + r2 * (-1.38888889e-3f + r2 * 2.48015873e-5f)));
+
+			// rotate the remainder back into its quadrant
+			float sx = (q & 1) ? c : s;
+			float cx = (q & 1) ? s : c;
+			gx = (q & 2) ? -sx : sx;
+			gy = ((q ^ (q >> 1)) & 1) ? -cx : cx;
+		}
+
+		static inline void tableGradient(const GradientTable& table, int ix, int iy, float& gx, float& gy)
+		{
+			int32_t h{ table.perm[table.perm[ix & 255] + (iy & 255)] & 15 };
+			gx = table.gx[h];
+			gy = table.gy[h];
+		}
+	}
+}
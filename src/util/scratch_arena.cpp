@@ -0,0 +1,141 @@
+#include "scratch_arena.h"
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <stdexcept>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace evn_util {
+	static std::atomic<bool> s_local_huge_pages{ false };
+#ifdef __linux__
+	const static size_t HUGE_PAGE_SIZE = 2 << 20;
+#endif
+
+	static size_t alignUp(size_t bytes, size_t alignment)
+	{
+		return (bytes + alignment - 1) / alignment * alignment;
+	}
+
+	ScratchArena::Scope::Scope(ScratchArena& arena)
+		: r_arena(arena), m_block(arena.m_block), m_offset(arena.m_offset)
+	{}
+
+	ScratchArena::Scope::~Scope()
+	{
+		r_arena.rewind(m_block, m_offset);
+	}
+
+	ScratchArena::ScratchArena(size_t capacity, bool huge_pages)
+		: m_block(0), m_offset(0), m_used_before(0), m_huge_pages(huge_pages)
+	{
+		if (capacity > 0)
+			addBlock(capacity);
+	}
+
+	ScratchArena::~ScratchArena()
+	{
+		for (Block& block : m_blocks)
+			releaseBlock(block);
+	}
+
+	ScratchArena& ScratchArena::local()
+	{
+		thread_local ScratchArena arena{ DEFAULT_CAPACITY, s_local_huge_pages.load() };
+		return arena;
+	}
+
+	void ScratchArena::setLocalHugePages(bool huge_pages)
+	{
+		s_local_huge_pages = huge_pages;
+	}
+
+	void* ScratchArena::allocateBytes(size_t bytes)
+	{
+		bytes = alignUp(bytes, ALIGNMENT);
+		if (m_blocks.empty() || m_offset + bytes > m_blocks[m_block].size) {
+			// move on to the next block, or chain on one at least as big as
+			// all the others so a chunk needs few of them
+			if (!m_blocks.empty()) {
+				m_used_before += m_blocks[m_block].size;
+				m_block++;
+			}
+			m_offset = 0;
+			if (m_block == m_blocks.size() || m_blocks[m_block].size < bytes)
+				addBlock(std::max(bytes, m_stats.bytes_reserved));
+		}
+
+		Block& block{ m_blocks[m_block] };
+		void* pointer{ block.base + m_offset };
+		size_t end{ m_offset + bytes };
+		if (block.touched > m_offset)
+			m_stats.bytes_reused += std::min(end, block.touched) - m_offset;
+		block.touched = std::max(block.touched, end);
+		m_offset = end;
+		m_stats.bytes_allocated += bytes;
+		m_stats.high_water = std::max(m_stats.high_water, m_used_before + m_offset);
+		return pointer;
+	}
+
+	void ScratchArena::rewind(size_t block, size_t offset)
+	{
+		m_block = block;
+		m_offset = offset;
+		m_used_before = 0;
+		for (size_t i{ 0 }; i < m_block; i++)
+			m_used_before += m_blocks[i].size;
+
+		// nothing is in use, merge the chain so the next time fits in one
+		if (m_block == 0 && m_offset == 0 && m_blocks.size() > 1) {
+			size_t total{ m_stats.bytes_reserved };
+			for (Block& chained : m_blocks)
+				releaseBlock(chained);
+			m_blocks.clear();
+			addBlock(total);
+		}
+	}
+
+	void ScratchArena::addBlock(size_t bytes)
+	{
+		Block block{ nullptr, alignUp(bytes, ALIGNMENT), 0, false };
+#ifdef __linux__
+		if (m_huge_pages) {
+			block.size = alignUp(block.size, HUGE_PAGE_SIZE);
+			void* pointer{ mmap(nullptr, block.size, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0) };
+			if (pointer == MAP_FAILED) {
+				// no reserved huge pages, ask for transparent ones instead
+				pointer = mmap(nullptr, block.size, PROT_READ | PROT_WRITE,
+					MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+				if (pointer != MAP_FAILED)
+					madvise(pointer, block.size, MADV_HUGEPAGE);
+			}
+			if (pointer == MAP_FAILED)
+				throw std::runtime_error("failed to map scratch arena block!");
+			block.base = (char*)pointer;
+			block.mapped = true;
+		}
+#endif
+		if (!block.base)
+			block.base = (char*)::operator new(block.size, std::align_val_t(ALIGNMENT));
+
+		// blocks stay in the order they are used in
+		m_blocks.insert(m_blocks.begin() + std::min(m_block, m_blocks.size()), block);
+		m_stats.heap_allocations++;
+		m_stats.bytes_reserved += block.size;
+	}
+
+	void ScratchArena::releaseBlock(Block& block)
+	{
+#ifdef __linux__
+		if (block.mapped) {
+			munmap(block.base, block.size);
+			m_stats.bytes_reserved -= block.size;
+			return;
+		}
+#endif
+		::operator delete(block.base, std::align_val_t(ALIGNMENT));
+		m_stats.bytes_reserved -= block.size;
+	}
+}
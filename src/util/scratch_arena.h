@@ -0,0 +1,114 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <type_traits>
+#include <vector>
+
+namespace evn_util {
+	// count Ts carved out of a ScratchArena, valid until the arena is
+	// rewound past them. the values start out uninitialised
+	template<typename T>
+	struct ScratchArray {
+		T* ptr{ nullptr };
+		size_t count{ 0 };
+
+		inline T* data() const { return ptr; }
+		inline size_t size() const { return count; }
+		inline bool empty() const { return count == 0; }
+		inline T* begin() const { return ptr; }
+		inline T* end() const { return ptr + count; }
+		inline T& operator[](size_t index) const { return ptr[index]; }
+	};
+
+	// linear allocator for the short lived arrays of chunk generation.
+	// allocations bump a pointer through one block and are all dropped at
+	// once when a Scope closes. when a chunk needs more than the block holds
+	// another is chained on, and once nothing is left in use they are
+	// merged into one block big enough for both. from then on generating
+	// chunks of that size doesn't touch the heap at all
+	class ScratchArena {
+	public:
+		struct Stats {
+			// blocks taken from the heap or the os
+			size_t heap_allocations{ 0 };
+			// bytes of blocks currently held
+			size_t bytes_reserved{ 0 };
+			// bytes handed out, and how many of them were handed out before
+			size_t bytes_allocated{ 0 };
+			size_t bytes_reused{ 0 };
+			// most bytes in use at once
+			size_t high_water{ 0 };
+		};
+
+		// everything allocated while the scope is open is released when it
+		// closes. scopes nest
+		class Scope {
+		public:
+			Scope(ScratchArena& arena);
+			~Scope();
+			Scope(const Scope&) = delete;
+			Scope& operator=(const Scope&) = delete;
+		private:
+			ScratchArena& r_arena;
+			size_t m_block;
+			size_t m_offset;
+		};
+
+		// huge_pages asks for 2 MB pages, falling back to transparent huge
+		// pages and then to normal ones where they aren't available
+		explicit ScratchArena(size_t capacity = DEFAULT_CAPACITY, bool huge_pages = false);
+		~ScratchArena();
+		ScratchArena(const ScratchArena&) = delete;
+		ScratchArena& operator=(const ScratchArena&) = delete;
+
+		template<typename T>
+		ScratchArray<T> allocate(size_t count)
+		{
+			static_assert(std::is_trivially_destructible<T>::value, "scratch arrays are never destroyed");
+			if (count == 0)
+				return {};
+			return { (T*)allocateBytes(sizeof(T) * count), count };
+		}
+		template<typename T>
+		ScratchArray<T> allocate(size_t count, const T& value)
+		{
+			ScratchArray<T> array{ allocate<T>(count) };
+			for (T& element : array)
+				element = value;
+			return array;
+		}
+
+		inline const Stats& stats() const { return m_stats; }
+		inline bool hugePages() const { return m_huge_pages; }
+
+		// the calling thread's arena, made on first use
+		static ScratchArena& local();
+		// whether arenas local() makes from now on ask for huge pages
+		static void setLocalHugePages(bool huge_pages);
+	public:
+		const static size_t DEFAULT_CAPACITY = 4 << 20;
+		// every allocation starts on a cache line, and so a simd boundary
+		const static size_t ALIGNMENT = 64;
+	private:
+		struct Block {
+			char* base;
+			size_t size;
+			// bytes of the block handed out at some point since it was made
+			size_t touched;
+			bool mapped;
+		};
+		void* allocateBytes(size_t bytes);
+		void rewind(size_t block, size_t offset);
+		void addBlock(size_t bytes);
+		void releaseBlock(Block& block);
+	private:
+		std::vector<Block> m_blocks;
+		// the block being bumped through and how far into it
+		size_t m_block;
+		size_t m_offset;
+		// size of the blocks before m_block, counted as in use
+		size_t m_used_before;
+		bool m_huge_pages;
+		Stats m_stats;
+	};
+}
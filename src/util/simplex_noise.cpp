@@ -0,0 +1,311 @@
+#include "simplex_noise.h"
+#include <math.h>
+#include <algorithm>
+
+namespace evn_util {
+	// skew from the square lattice to the triangle lattice and back
+	static const float F2{ 0.366025403784f }; // (sqrt(3) - 1) / 2
+	static const float G2{ 0.211324865405f }; // (3 - sqrt(3)) / 6
+	// brings the sum of the 3 corners to the same range as PerlinNoise
+	static const float SCALE{ 70.0f };
+	// largest |simplex()|. dense sampling peaks near 0.71, the margin
+	// covers the slope between the samples
+	static const float AMPLITUDE{ 0.76f };
+	// boxes reaching more lattice corners than this are bounded by the
+	// amplitude instead
+	static const int MAX_BOUND_CORNERS{ 64 };
+
+	// std::floor is a library call without sse4.1, and simplex can't rely on
+	// the inputs being positive like perlin does
+	static inline int fastFloor(float v)
+	{
+		int i{ (int)v };
+		return v < (float)i ? i - 1 : i;
+	}
+
+	SimplexNoise::SimplexNoise(uint16_t cell_dimensions, uint32_t seed)
+		: m_dimensions(cell_dimensions), r_gradients(unitGradients())
+	{
+		buildPermutation(seed, m_permutation);
+	}
+
+	SimplexNoise::~SimplexNoise()
+	{}
+
+	float SimplexNoise::simplex(float x, float y) const
+	{
+		// find the triangle the point is in
+		float s{ (x + y) * F2 };
+		int i{ fastFloor(x + s) };
+		int j{ fastFloor(y + s) };
+		float t{ (float)(i + j) * G2 };
+
+		// distance to the first corner in unskewed space
+		float x0{ x - ((float)i - t) };
+		float y0{ y - ((float)j - t) };
+
+		// lower or upper triangle of the skewed square
+		int i1{ x0 > y0 ? 1 : 0 };
+		int j1{ 1 - i1 };
+
+		float x1{ x0 - (float)i1 + G2 };
+		float y1{ y0 - (float)j1 + G2 };
+		float x2{ x0 - 1.0f + 2.0f * G2 };
+		float y2{ y0 - 1.0f + 2.0f * G2 };
+
+		float n{ cornerContribution(i, j, x0, y0) };
+		n += cornerContribution(i + i1, j + j1, x1, y1);
+		n += cornerContribution(i + 1, j + 1, x2, y2);
+		return SCALE * n;
+	}
+
+	float SimplexNoise::simplexDerivatives(float x, float y, float& dx, float& dy) const
+	{
+		// same lattice walk as simplex(), the corner offsets move one to one
+		// with the sample so their derivatives are the identity
+		float s{ (x + y) * F2 };
+		int i{ fastFloor(x + s) };
+		int j{ fastFloor(y + s) };
+		float t{ (float)(i + j) * G2 };
+
+		float x0{ x - ((float)i - t) };
+		float y0{ y - ((float)j - t) };
+		int i1{ x0 > y0 ? 1 : 0 };
+		int j1{ 1 - i1 };
+		float x1{ x0 - (float)i1 + G2 };
+		float y1{ y0 - (float)j1 + G2 };
+		float x2{ x0 - 1.0f + 2.0f * G2 };
+		float y2{ y0 - 1.0f + 2.0f * G2 };
+
+		dx = 0.0f;
+		dy = 0.0f;
+		float n{ cornerDerivatives(i, j, x0, y0, dx, dy) };
+		n += cornerDerivatives(i + i1, j + j1, x1, y1, dx, dy);
+		n += cornerDerivatives(i + 1, j + 1, x2, y2, dx, dy);
+		dx *= SCALE;
+		dy *= SCALE;
+		return SCALE * n;
+	}
+
+	float SimplexNoise::octaveSimplexDerivatives(float x, float y, float& dx, float& dy, int octaves,
+		float persistence, float cutoff) const
+	{
+		float val{ 0.0f };
+		float freq{ 1 };
+		float amp{ 1 };
+		float rest{ cutoff == NO_CUTOFF ? 0.0f : remainingAmplitude(octaves, persistence) };
+		dx = 0.0f;
+		dy = 0.0f;
+
+		for (int i = 0; i < octaves; i++) {
+			if (val + rest < cutoff) break;
+			rest -= fabsf(amp) * AMPLITUDE;
+			float gx, gy;
+			val += simplexDerivatives(x * freq / m_dimensions, y * freq / m_dimensions, gx, gy) * amp;
+			dx += gx * amp * freq / m_dimensions;
+			dy += gy * amp * freq / m_dimensions;
+			freq *= 2;
+			amp *= persistence;
+		}
+
+		return val;
+	}
+
+	float SimplexNoise::octaveSimplex(float x, float y, int octaves, float persistence, float cutoff) const
+	{
+		float val{ 0.0f };
+		float freq{ 1 };
+		float amp{ 1 };
+		float rest{ cutoff == NO_CUTOFF ? 0.0f : remainingAmplitude(octaves, persistence) };
+
+		for (int i = 0; i < octaves; i++) {
+			if (val + rest < cutoff) break;
+			rest -= fabsf(amp) * AMPLITUDE;
+			val += simplex(x * freq / m_dimensions, y * freq / m_dimensions) * amp;
+			freq *= 2;
+			amp *= persistence;
+		}
+
+		return val;
+	}
+
+	void SimplexNoise::octaveSimplexGrid(const float* xs, int width, const float* ys, int height,
+		float* out, int octaves, float persistence, float cutoff) const
+	{
+		// the triangle lattice isn't separable, so there is nothing to share
+		// between samples
+		for (int y{ 0 }; y < height; y++)
+			for (int x{ 0 }; x < width; x++)
+				out[(size_t)y * width + x] = octaveSimplex(xs[x], ys[y], octaves, persistence, cutoff);
+	}
+
+	float SimplexNoise::remainingAmplitude(int octaves, float persistence) const
+	{
+		// a hair over the total so rounding in the sum can't cross the cutoff
+		float rest{ 0.0f };
+		float amp{ 1 };
+		for (int i = 0; i < octaves; i++) {
+			rest += fabsf(amp) * AMPLITUDE;
+			amp *= persistence;
+		}
+		return rest * 1.0001f;
+	}
+
+	float SimplexNoise::noise(float x, float y)
+	{
+		return simplex(x, y);
+	}
+
+	float SimplexNoise::octaveNoise(float x, float y, int octaves, float persistence)
+	{
+		return octaveSimplex(x, y, octaves, persistence);
+	}
+
+	void SimplexNoise::octaveNoiseGrid(const float* xs, int width, const float* ys, int height,
+		float* out, int octaves, float persistence, float cutoff)
+	{
+		octaveSimplexGrid(xs, width, ys, height, out, octaves, persistence, cutoff);
+	}
+
+	void SimplexNoise::octaveNoiseBatch(const float* x, const float* y, float* out, size_t count,
+		int octaves, float persistence)
+	{
+		for (size_t i{ 0 }; i < count; i++)
+			out[i] = octaveSimplex(x[i], y[i], octaves, persistence);
+	}
+
+	void SimplexNoise::octaveNoiseGridDerivatives(const float* xs, int width, const float* ys, int height,
+		float* out, float* out_dx, float* out_dy, int octaves, float persistence, float cutoff)
+	{
+		for (int y{ 0 }; y < height; y++) {
+			for (int x{ 0 }; x < width; x++) {
+				size_t i{ (size_t)y * width + x };
+				out[i] = octaveSimplexDerivatives(xs[x], ys[y], out_dx[i], out_dy[i], octaves,
+					persistence, cutoff);
+			}
+		}
+	}
+
+	void SimplexNoise::octaveNoiseBatchDerivatives(const float* x, const float* y, float* out,
+		float* out_dx, float* out_dy, size_t count, int octaves, float persistence)
+	{
+		for (size_t i{ 0 }; i < count; i++)
+			out[i] = octaveSimplexDerivatives(x[i], y[i], out_dx[i], out_dy[i], octaves, persistence);
+	}
+
+	float SimplexNoise::amplitude() const
+	{
+		return AMPLITUDE;
+	}
+
+	void SimplexNoise::octaveNoiseBounds(float x0, float x1, float y0, float y1, int octaves,
+		float persistence, float& low, float& high)
+	{
+		low = 0.0f;
+		high = 0.0f;
+		float freq{ 1 };
+		float amp{ 1 };
+		for (int o{ 0 }; o < octaves; o++) {
+			float scale{ freq / m_dimensions };
+			float octave_low{ -AMPLITUDE };
+			float octave_high{ AMPLITUDE };
+			// the fine octaves reach too many corners and keep the amplitude
+			if (simplexBounds(x0 * scale, x1 * scale, y0 * scale, y1 * scale, octave_low, octave_high)) {
+				octave_low = std::max(octave_low, -AMPLITUDE);
+				octave_high = std::min(octave_high, AMPLITUDE);
+			}
+			low += amp >= 0.0f ? octave_low * amp : octave_high * amp;
+			high += amp >= 0.0f ? octave_high * amp : octave_low * amp;
+			freq *= 2;
+			amp *= persistence;
+		}
+		// rounding in the sum and in the corner offsets
+		low -= 1e-4f;
+		high += 1e-4f;
+	}
+
+	bool SimplexNoise::simplexBounds(float x0, float x1, float y0, float y1, float& low, float& high) const
+	{
+		// corners further than sqrt(0.5) from the box can't reach it. the
+		// skew only grows coordinates, so skewing the grown box's corners
+		// gives the range of lattice indices to look at
+		const float reach{ 0.7072f };
+		float gx0{ x0 - reach }, gx1{ x1 + reach };
+		float gy0{ y0 - reach }, gy1{ y1 + reach };
+		int i0{ fastFloor(gx0 + (gx0 + gy0) * F2) }, i1{ fastFloor(gx1 + (gx1 + gy1) * F2) };
+		int j0{ fastFloor(gy0 + (gx0 + gy0) * F2) }, j1{ fastFloor(gy1 + (gx1 + gy1) * F2) };
+		if ((i1 - i0 + 1) * (j1 - j0 + 1) > MAX_BOUND_CORNERS * 4)
+			return false;
+
+		// each corner adds t^4 * (g . r) with r the offset from the corner
+		// and t = max(0.5 - |r|^2, 0). the ranges of t^4 and g . r over the
+		// box bound its share
+		float sum_low{ 0.0f };
+		float sum_high{ 0.0f };
+		int corners{ 0 };
+		for (int j{ j0 }; j <= j1; j++) {
+			for (int i{ i0 }; i <= i1; i++) {
+				float t{ (float)(i + j) * G2 };
+				float cx{ (float)i - t };
+				float cy{ (float)j - t };
+				// the box relative to the corner
+				float rx0{ x0 - cx }, rx1{ x1 - cx };
+				float ry0{ y0 - cy }, ry1{ y1 - cy };
+				float near_x{ rx0 > 0.0f ? rx0 : (rx1 < 0.0f ? rx1 : 0.0f) };
+				float near_y{ ry0 > 0.0f ? ry0 : (ry1 < 0.0f ? ry1 : 0.0f) };
+				float near{ near_x * near_x + near_y * near_y };
+				if (near >= 0.5f) continue;
+				if (++corners > MAX_BOUND_CORNERS) return false;
+
+				float far_x{ std::max(fabsf(rx0), fabsf(rx1)) };
+				float far_y{ std::max(fabsf(ry0), fabsf(ry1)) };
+				float t_low{ std::max(0.5f - far_x * far_x - far_y * far_y, 0.0f) };
+				float t_high{ 0.5f - near };
+				t_low *= t_low;
+				t_low *= t_low;
+				t_high *= t_high;
+				t_high *= t_high;
+
+				int h{ m_permutation[m_permutation[i & 255] + (j & 255)] & 15 };
+				float g_x{ r_gradients.x[h] };
+				float g_y{ r_gradients.y[h] };
+				float dot_low{ std::min(g_x * rx0, g_x * rx1) + std::min(g_y * ry0, g_y * ry1) };
+				float dot_high{ std::max(g_x * rx0, g_x * rx1) + std::max(g_y * ry0, g_y * ry1) };
+				// t^4 is never negative, the extremes are at one of its ends
+				sum_low += std::min(t_low * dot_low, t_high * dot_low);
+				sum_high += std::max(t_low * dot_high, t_high * dot_high);
+			}
+		}
+		low = SCALE * sum_low;
+		high = SCALE * sum_high;
+		return true;
+	}
+
+	float SimplexNoise::cornerContribution(int i, int j, float x, float y) const
+	{
+		// radial falloff, corners further than sqrt(0.5) don't contribute
+		float t{ 0.5f - x * x - y * y };
+		if (t < 0.0f) return 0.0f;
+
+		int h{ m_permutation[m_permutation[i & 255] + (j & 255)] & 15 };
+		t *= t;
+		return t * t * (x * r_gradients.x[h] + y * r_gradients.y[h]);
+	}
+
+	float SimplexNoise::cornerDerivatives(int i, int j, float x, float y, float& dx, float& dy) const
+	{
+		float t{ 0.5f - x * x - y * y };
+		if (t < 0.0f) return 0.0f;
+
+		int h{ m_permutation[m_permutation[i & 255] + (j & 255)] & 15 };
+		float gx{ r_gradients.x[h] };
+		float gy{ r_gradients.y[h] };
+		float dot{ x * gx + y * gy };
+		float t2{ t * t };
+		float t4{ t2 * t2 };
+		// d/dx of t^4 * dot is t^4 * gx - 8 * t^3 * x * dot
+		dx += t4 * gx - 8.0f * t * t2 * x * dot;
+		dy += t4 * gy - 8.0f * t * t2 * y * dot;
+		return t4 * dot;
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include "noise.h"
+
+namespace evn_util {
+	// 2d simplex noise. each sample blends the 3 corners of a triangle of the
+	// skewed lattice instead of the 4 corners of a square, so it is cheaper
+	// than classic perlin and doesn't line features up with the axes
+	class SimplexNoise : public NoiseEngine {
+	public:
+		SimplexNoise(uint16_t cell_dimensions, uint32_t seed=0);
+		~SimplexNoise();
+		float simplex(float x, float y) const;
+		// octaves stop early once the sum can't get back up to cutoff
+		float octaveSimplex(float x, float y, int octaves, float persistence=0.5,
+			float cutoff=NO_CUTOFF) const;
+		void octaveSimplexGrid(const float* xs, int width, const float* ys, int height,
+			float* out, int octaves, float persistence=0.5, float cutoff=NO_CUTOFF) const;
+		// simplex with its partial derivatives, from the radial falloff and
+		// the corner gradients
+		float simplexDerivatives(float x, float y, float& dx, float& dy) const;
+		float octaveSimplexDerivatives(float x, float y, float& dx, float& dy, int octaves,
+			float persistence=0.5, float cutoff=NO_CUTOFF) const;
+		// NoiseEngine
+		float noise(float x, float y) override;
+		float octaveNoise(float x, float y, int octaves, float persistence=0.5) override;
+		void octaveNoiseGrid(const float* xs, int width, const float* ys, int height,
+			float* out, int octaves, float persistence=0.5, float cutoff=NO_CUTOFF) override;
+		void octaveNoiseBatch(const float* x, const float* y, float* out, size_t count,
+			int octaves, float persistence=0.5) override;
+		void octaveNoiseGridDerivatives(const float* xs, int width, const float* ys, int height,
+			float* out, float* out_dx, float* out_dy, int octaves, float persistence=0.5,
+			float cutoff=NO_CUTOFF) override;
+		void octaveNoiseBatchDerivatives(const float* x, const float* y, float* out,
+			float* out_dx, float* out_dy, size_t count, int octaves, float persistence=0.5) override;
+		float amplitude() const override;
+		void octaveNoiseBounds(float x0, float x1, float y0, float y1, int octaves,
+			float persistence, float& low, float& high) override;
+	private:
+		// the most octaves [0, octaves) can add up to, with a little slack
+		float remainingAmplitude(int octaves, float persistence) const;
+		// range of simplex() over a box in lattice units from the corners
+		// whose falloff reaches it. false when the box reaches more than
+		// MAX_BOUND_CORNERS, the amplitude is as tight then
+		bool simplexBounds(float x0, float x1, float y0, float y1, float& low, float& high) const;
+		float cornerContribution(int i, int j, float x, float y) const;
+		// adds the corner's derivative to dx, dy
+		float cornerDerivatives(int i, int j, float x, float y, float& dx, float& dy) const;
+	private:
+		uint16_t m_dimensions;
+		std::vector<int32_t> m_permutation;
+		const UnitGradients& r_gradients;
+	};
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <stddef.h>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace evn_util {
+	// recycles the objects chunks stage their generated data in between a
+	// worker's generate and the render thread's upload. the scratch arena
+	// can't hold that data, it rewinds on the worker before the upload
+	// happens. an object comes back to the pool when its handle is dropped
+	// and keeps whatever its vectors had reserved, so once the pool has as
+	// many as are ever in flight at once staging a chunk doesn't touch the
+	// heap. acquire and release are safe from any thread
+	template<typename T>
+	class StagingPool {
+	public:
+		// hands its object back to the pool it came from
+		struct Release {
+			StagingPool* p_pool{ nullptr };
+			void operator()(T* object) const { p_pool->release(object); }
+		};
+		using Handle = std::unique_ptr<T, Release>;
+
+		struct Stats {
+			// objects made because none were free
+			size_t heap_allocations{ 0 };
+			// objects handed out again
+			size_t reused{ 0 };
+		};
+
+		explicit StagingPool(size_t max_free = DEFAULT_MAX_FREE)
+			: m_max_free(max_free)
+		{
+			m_free.reserve(max_free);
+		}
+		StagingPool(const StagingPool&) = delete;
+		StagingPool& operator=(const StagingPool&) = delete;
+
+		// a free object as it was released, or a new one. the caller sizes
+		// or clears what it uses
+		Handle acquire()
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				if (!m_free.empty()) {
+					T* object{ m_free.back().release() };
+					m_free.pop_back();
+					m_stats.reused++;
+					return Handle(object, Release{ this });
+				}
+				m_stats.heap_allocations++;
+			}
+			return Handle(new T{}, Release{ this });
+		}
+
+		Stats stats()
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			return m_stats;
+		}
+
+		// one pool per staged type, shared by every chunk of that type. it
+		// outlives the chunks, which are gone before statics are destroyed
+		static StagingPool& shared()
+		{
+			static StagingPool pool;
+			return pool;
+		}
+	public:
+		// more in flight than this at once only happens in bursts, the
+		// extra objects are freed rather than kept for the next one
+		const static size_t DEFAULT_MAX_FREE = 32;
+	private:
+		void release(T* object)
+		{
+			std::unique_ptr<T> owned(object);
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_free.size() < m_max_free)
+				m_free.push_back(std::move(owned));
+		}
+	private:
+		std::mutex m_mutex;
+		std::vector<std::unique_ptr<T>> m_free;
+		size_t m_max_free;
+		Stats m_stats;
+	};
+}
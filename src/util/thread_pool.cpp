@@ -0,0 +1,56 @@
+#include "thread_pool.h"
+#include <algorithm>
+
+namespace evn_util {
+	ThreadPool::ThreadPool(unsigned threads)
+		: m_stopping(false)
+	{
+		if (threads == 0)
+			threads = std::max(2u, std::thread::hardware_concurrency()) - 1;
+		for (unsigned i{ 0 }; i < threads; i++)
+			m_threads.emplace_back(&ThreadPool::run, this);
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stopping = true;
+			m_jobs.clear();
+		}
+		m_wake.notify_all();
+		for (auto& thread : m_threads)
+			thread.join();
+	}
+
+	void ThreadPool::submit(std::function<void()> job)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_jobs.push_back(std::move(job));
+		}
+		m_wake.notify_one();
+	}
+
+	size_t ThreadPool::pending()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_jobs.size();
+	}
+
+	void ThreadPool::run()
+	{
+		for (;;) {
+			std::function<void()> job;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_wake.wait(lock, [this] { return m_stopping || !m_jobs.empty(); });
+				if (m_stopping)
+					return;
+				job = std::move(m_jobs.front());
+				m_jobs.pop_front();
+			}
+			job();
+		}
+	}
+}
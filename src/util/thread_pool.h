@@ -0,0 +1,36 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace evn_util {
+	// fixed set of worker threads running submitted jobs in the order they
+	// came in. jobs report back however they like, EndlessTerrain hands its
+	// finished chunks over an MpmcQueue
+	class ThreadPool {
+	public:
+		// 0 leaves one hardware thread to the caller and uses the rest,
+		// there is always at least one worker
+		explicit ThreadPool(unsigned threads = 0);
+		// jobs that haven't started are dropped, running ones are waited on
+		~ThreadPool();
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		void submit(std::function<void()> job);
+		inline unsigned threadCount() const { return (unsigned)m_threads.size(); }
+		// jobs waiting for a worker
+		size_t pending();
+	private:
+		void run();
+	private:
+		std::vector<std::thread> m_threads;
+		std::deque<std::function<void()>> m_jobs;
+		std::mutex m_mutex;
+		std::condition_variable m_wake;
+		bool m_stopping;
+	};
+}